@@ -0,0 +1,127 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_COLLISION_CACHE_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_COLLISION_CACHE_
+
+#include <moveit/setup_assistant/tools/compute_default_collisions.h>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Verdicts of link pairs, by a key that covers everything the verdict depends on, stored in a local file.
+ *
+ * The binary file starts with the 8 bytes "MSACACHE", a 32 bit format version, the 32 bit generation of the run that
+ * wrote it and a 32 bit record count. Records follow in ascending key order, 22 bytes each: 64 bit key, 8 bit reason,
+ * 8 bit disabled flag, 32 bit float collision frequency, 32 bit float minimum distance and the 32 bit generation of the
+ * last run that used the record. All numbers are little-endian. Files of version 1 lack the generations, files before
+ * version 3 number the reasons in an older order.
+ *
+ * Every load starts a new generation. When saving a cache with more than getMaxEntries() entries, the ones used least
+ * recently are dropped, so entries of robots and settings no longer in use do not pile up.
+ *
+ * Lookups and stores may come from computations running in parallel, loading and saving must not overlap with them.
+ */
+class CollisionCache : private boost::noncopyable
+{
+public:
+  CollisionCache();
+
+  /**
+   * \brief Replace the entries with the ones of a file written by save()
+   * \return false if the file cannot be read or has another format, the cache is empty then
+   */
+  bool load(const std::string &file_path);
+
+  /**
+   * \brief Write the entries to a file, at most getMaxEntries() of the most recently used ones. The file is replaced
+   * at once, so readers never see a partial file
+   * \return false if the file cannot be written
+   */
+  bool save(const std::string &file_path) const;
+
+  /**
+   * \brief Look up the verdict of a key and mark it as used by this run
+   * \return false if the key is not in the cache
+   */
+  bool lookup(boost::uint64_t key, LinkPairData &data);
+
+  /// Add or replace the verdict of a key, marked as used by this run
+  void store(boost::uint64_t key, const LinkPairData &data);
+
+  /// Most entries written by save(), 0 for no limit
+  std::size_t getMaxEntries() const
+  {
+    return max_entries_;
+  }
+
+  /// Set the most entries written by save(), 0 for no limit
+  void setMaxEntries(std::size_t max_entries)
+  {
+    max_entries_ = max_entries;
+  }
+
+  /// Number of entries
+  std::size_t size() const
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    return entries_.size();
+  }
+
+  /// Default of getMaxEntries(), about 4 MB on disk
+  static const std::size_t DEFAULT_MAX_ENTRIES = 200000;
+
+private:
+  /// Verdict of a key and the generation of the last run that used it
+  struct Entry
+  {
+    LinkPairData data;
+    boost::uint32_t generation;
+  };
+
+  mutable boost::mutex mutex_; // guards entries_ for lookup() and store()
+  std::map<boost::uint64_t, Entry> entries_;
+  boost::uint32_t generation_;
+  std::size_t max_entries_;
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_COLLISION_CHECKPOINT_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_COLLISION_CHECKPOINT_
+
+#include <boost/cstdint.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <string>
+#include <vector>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief State of the never in collision trials after a complete round. Samples are indexed, so the number of trials
+ * done is the position in the sample sequence, and a run continued from a checkpoint gives the same result as an
+ * uninterrupted run with the same seed.
+ *
+ * The binary file starts with the 8 bytes "MSACHKPT" and a 32 bit format version. Numbers are written in the byte
+ * order of the machine, a checkpoint is meant to be resumed on the same kind of machine.
+ */
+struct CollisionCheckpoint
+{
+  CollisionCheckpoint() : key(0), trials_done(0), focused_trials(0), last_discovery(0) {};
+
+  /// Hash of the robot and the settings the trials depend on, a checkpoint only continues a run with the same key
+  boost::uint64_t key;
+
+  /// Number of trials done, the first trial of the next round
+  unsigned int trials_done;
+
+  /// Number of focused trials among them
+  unsigned int focused_trials;
+
+  /// Trials until the last pair was seen colliding for the first time
+  unsigned int last_discovery;
+
+  /// Pairs seen colliding, by pair index
+  boost::dynamic_bitset<> seen_colliding;
+
+  /// Pairs that came closer than the near miss margin, by pair index
+  boost::dynamic_bitset<> near_pairs;
+
+  /// Collisions in the uniform trials by pair index, empty if collisions are not counted
+  std::vector<unsigned int> collision_count;
+
+  /// Smallest distance by pair index, empty if no distances are measured
+  std::vector<float> min_distance;
+
+  /// Distance of the link origins in the closest state of every pair, empty if trials are not focused
+  std::vector<double> closest_distance;
+
+  /// Trial of the closest state of every pair
+  std::vector<unsigned int> closest_trial;
+
+  /// Positions of the closest state of every pair, empty for pairs without one
+  std::vector<std::vector<double> > closest_positions;
+};
+
+/**
+ * \brief Read a checkpoint from a file written by saveCollisionCheckpoint()
+ * \return false if the file cannot be read or has another format
+ */
+bool loadCollisionCheckpoint(const std::string &file_path, CollisionCheckpoint &checkpoint);
+
+/**
+ * \brief Write a checkpoint to a file. The file is replaced at once, so an interrupted write keeps the old checkpoint
+ * \return false if the file cannot be written
+ */
+bool saveCollisionCheckpoint(const std::string &file_path, const CollisionCheckpoint &checkpoint);
+
+}
+
+#endif
@@ -38,15 +38,28 @@
 #define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_COMPUTE_DEFAULT_COLLISIONS_
 
 #include <moveit/planning_scene/planning_scene.h>
+#include <moveit/setup_assistant/tools/joint_space_sampler.h>
+#include <moveit/setup_assistant/tools/link_hash.h>
+#include <boost/unordered_map.hpp>
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
 
 namespace moveit_setup_assistant
 {
 
+class CollisionCache;
+
 /**
  * \brief Reasons for disabling link pairs. Append "in collision" for understanding.
- * NOT_DISABLED means the link pair DOES do self collision checking
+ * UNREACHABLE means the bounding volumes of everything the two links can reach never intersect.
+ * RARELY means the pair collided in at most DefaultCollisionsRequest::max_collision_frequency of the trials.
+ * NOT_DISABLED means the link pair DOES do self collision checking.
+ * The values are stored in collision caches, new reasons go at the end
  */
-enum DisabledReason { NEVER, DEFAULT, ADJACENT, ALWAYS, USER, NOT_DISABLED };
+enum DisabledReason { NEVER, DEFAULT, ADJACENT, ALWAYS, USER, NOT_DISABLED, UNREACHABLE, RARELY };
 
 /**
  * \brief Store details on a pair of links
@@ -54,9 +67,18 @@ enum DisabledReason { NEVER, DEFAULT, ADJACENT, ALWAYS, USER, NOT_DISABLED };
 struct LinkPairData
 {
   // by default all link pairs are NOT disabled for collision checking
-  LinkPairData() : reason( NOT_DISABLED ), disable_check( false ) {};
+  LinkPairData() : reason( NOT_DISABLED ), disable_check( false ), collision_frequency( -1.0 ), min_distance( -1.0 ) {};
   DisabledReason reason;
   bool disable_check;
+
+  /// Fraction of the never in collision trials in which the pair collided, negative if it was not measured
+  double collision_frequency;
+
+  /**
+   * Smallest distance between the links in the never in collision trials, negative if it was not measured, 0 if the
+   * links collided. Exact if it is within the near-miss margin, otherwise a lower bound
+   */
+  double min_distance;
 };
 
 /**
@@ -64,6 +86,537 @@ struct LinkPairData
  */
 typedef std::map<std::pair<std::string, std::string>, LinkPairData > LinkPairMap;
 
+/**
+ * \brief Index-based counterpart of LinkPairMap, used while computing the collision matrix.
+ *
+ * Link names are interned to contiguous ids in alphabetical order, so that id(A) < id(B) iff A < B and a pair
+ * keeps the same ordering as in LinkPairMap. The n choose 2 pairs are stored in a packed upper-triangular array
+ * holding one byte of reason/disable bits per pair.
+ */
+class LinkPairMatrix
+{
+public:
+  LinkPairMatrix();
+
+  /**
+   * \brief Intern the given link names and create all n choose 2 pairs, initially NOT_DISABLED
+   * \param link_names Names of the links, in any order. Duplicates are ignored
+   */
+  explicit LinkPairMatrix(const std::vector<std::string> &link_names);
+
+  /// Number of interned links
+  std::size_t linkCount() const
+  {
+    return names_.size();
+  }
+
+  /// Number of unique link pairs, n choose 2
+  std::size_t pairCount() const
+  {
+    return data_.size();
+  }
+
+  /// Id of a link, or -1 if the link is not part of the matrix
+  int linkId(const std::string &name) const;
+
+  /// Name of a link id
+  const std::string& linkName(int id) const
+  {
+    return names_[id];
+  }
+
+  /// Index of the pair of two different link ids in the packed triangle, independent of their order
+  std::size_t pairIndex(int a, int b) const
+  {
+    if (a > b)
+      std::swap(a, b);
+    return (std::size_t)a * (2 * names_.size() - a - 1) / 2 + (b - a - 1);
+  }
+
+  /**
+   * \brief Look up the index of a pair of link names
+   * \return false if one of the links is not part of the matrix or both names are equal
+   */
+  bool pairIndex(const std::string &linkA, const std::string &linkB, std::size_t &index) const;
+
+  /// Lower link id of a pair
+  int firstLink(std::size_t index) const
+  {
+    return pair_links_[index].first;
+  }
+
+  /// Higher link id of a pair
+  int secondLink(std::size_t index) const
+  {
+    return pair_links_[index].second;
+  }
+
+  /// Reason stored for a pair
+  DisabledReason reason(std::size_t index) const
+  {
+    return (DisabledReason)(data_[index] & REASON_MASK);
+  }
+
+  /// Whether collision checking is disabled for a pair
+  bool disabled(std::size_t index) const
+  {
+    return data_[index] & DISABLED_BIT;
+  }
+
+  /**
+   * \brief Disable a pair with the given reason. Same semantics as for LinkPairMap: the reason is only changed if
+   * the pair was not disabled before, NOT_DISABLED enables the pair again
+   * \return true if the pair was not disabled before
+   */
+  bool setLinkPair(std::size_t index, DisabledReason reason);
+
+  /// Overwrite the reason, disable flag and collision frequency of a pair
+  void setLinkPairData(std::size_t index, const LinkPairData &data);
+
+  /// Fraction of the trials in which a pair collided, negative if it was not measured
+  double collisionFrequency(std::size_t index) const
+  {
+    return frequency_[index];
+  }
+
+  /// Store the fraction of the trials in which a pair collided
+  void setCollisionFrequency(std::size_t index, double frequency)
+  {
+    frequency_[index] = frequency;
+  }
+
+  /// Smallest distance between the links of a pair, negative if it was not measured
+  double minDistance(std::size_t index) const
+  {
+    return distance_[index];
+  }
+
+  /// Store the smallest distance between the links of a pair
+  void setMinDistance(std::size_t index, double distance)
+  {
+    distance_[index] = distance;
+  }
+
+  /// Convert to the string-based representation
+  void toLinkPairMap(LinkPairMap &link_pairs) const;
+
+private:
+  static const unsigned char REASON_MASK = 0x7f;
+  static const unsigned char DISABLED_BIT = 0x80;
+
+  std::vector<std::string> names_;
+  boost::unordered_map<std::string, int> ids_;
+  std::vector<std::pair<int, int> > pair_links_;
+  std::vector<unsigned char> data_;
+  std::vector<float> frequency_; // single precision keeps the array compact
+  std::vector<float> distance_;
+};
+
+/**
+ * \brief Steps of computeDefaultCollisions(), in the order they run
+ */
+enum DefaultCollisionsPhase { PHASE_SETUP, PHASE_ADJACENT, PHASE_DEFAULT, PHASE_UNREACHABLE, PHASE_ALWAYS, PHASE_NEVER,
+                              PHASE_DONE };
+
+/**
+ * \brief Progress of a computeDefaultCollisions() run, which also allows to cancel the run.
+ *
+ * The computation and its worker threads update the object while any other thread may read it or cancel the run.
+ * The state is kept in atomics, so reading it never blocks the computation. Values read while a phase starts may
+ * belong partly to the old and partly to the new phase.
+ */
+class DefaultCollisionsProgress : private boost::noncopyable
+{
+public:
+  /// Called from the computing thread when a phase starts and after every round of samples
+  typedef boost::function<void (const DefaultCollisionsProgress&)> Callback;
+
+  DefaultCollisionsProgress();
+
+  /// Set the function called on updates. Must not be changed while a computation is running
+  void setCallback(const Callback &callback);
+
+  /// Ask the computation to stop as soon as possible. Safe to call from a signal handler
+  void cancel()
+  {
+    cancelled_ = true;
+  }
+
+  /// Whether cancel() was called
+  bool isCancelled() const
+  {
+    return cancelled_;
+  }
+
+  /// Phase currently running
+  DefaultCollisionsPhase getPhase() const;
+
+  /// Progress of the whole computation in percent
+  unsigned int getPercent() const;
+
+  /// Number of samples checked in the current phase, including the ones resumed from a checkpoint
+  unsigned int getSamplesDone() const
+  {
+    return samples_checked_ - phase_samples_begin_ + samples_resumed_;
+  }
+
+  /// Number of samples checked by this run in all phases so far. Wraps around, differences of two readings stay valid
+  unsigned int getSamplesChecked() const
+  {
+    return samples_checked_;
+  }
+
+  /// Number of samples the current phase checks at most, 0 if unknown
+  unsigned int getSamplesTotal() const;
+
+  /// Number of link pairs whose verdict is known
+  std::size_t getPairsResolved() const;
+
+  /// Number of link pairs
+  std::size_t getPairsTotal() const;
+
+  /// Seconds since the computation started
+  double getElapsedTime() const;
+
+  /// Estimated seconds until the current phase is finished, negative if unknown
+  double getRemainingTime() const;
+
+  /// Start a computation on the given number of link pairs
+  void start(std::size_t pairs_total);
+
+  /**
+   * \brief Enter a new phase and call the callback
+   * \param percent_begin Overall progress at the start of the phase
+   * \param percent_end Overall progress at the end of the phase, reached when samples_total samples are checked
+   * \param samples_total Number of samples the phase checks at most, 0 if unknown
+   */
+  void setPhase(DefaultCollisionsPhase phase, unsigned int percent_begin, unsigned int percent_end,
+                unsigned int samples_total = 0);
+
+  /// Update the number of samples the current phase checks at most, when the estimate changes during the phase
+  void setSamplesTotal(unsigned int samples_total);
+
+  /// Count checked samples, may be called from any thread
+  void addSamples(unsigned int samples)
+  {
+    samples_checked_ += samples;
+  }
+
+  /// Count samples of the current phase that an earlier run checked, they do not count for the rate of this run
+  void addResumedSamples(unsigned int samples)
+  {
+    samples_resumed_ += samples;
+  }
+
+  /// Update the number of resolved pairs
+  void setPairsResolved(std::size_t pairs_resolved);
+
+  /// Call the callback
+  void notify() const;
+
+private:
+  boost::atomic<bool> cancelled_;
+  boost::atomic<unsigned int> samples_checked_;
+  boost::atomic<unsigned int> phase_samples_begin_; // samples_checked_ when the current phase started
+  boost::atomic<unsigned int> samples_resumed_; // samples of the current phase taken from a checkpoint
+  boost::atomic<DefaultCollisionsPhase> phase_;
+  boost::atomic<unsigned int> percent_begin_;
+  boost::atomic<unsigned int> percent_end_;
+  boost::atomic<unsigned int> samples_total_;
+  boost::atomic<std::size_t> pairs_resolved_;
+  boost::atomic<std::size_t> pairs_total_;
+  boost::atomic<double> start_time_; // wall time in seconds
+  boost::atomic<double> phase_start_time_;
+
+  mutable boost::mutex mutex_; // guards callback_
+  Callback callback_;
+};
+
+/**
+ * \brief Parameters of computeDefaultCollisions()
+ */
+struct DefaultCollisionsRequest
+{
+  DefaultCollisionsRequest()
+    : include_never_colliding(true), trials(10000), min_collision_fraction(0.95), verbose(false),
+      termination_confidence(0.95), max_discovery_rate(0.0), sampler(UNIFORM_RANDOM), seed(-1),
+      previous_link_pairs(NULL), previous_link_hashes(NULL), previous_settings_hash(0),
+      record_collision_frequency(false),
+      max_collision_frequency(0.0), near_miss_margin(0.0), focus_fraction(0.0), focus_radius(0.1),
+      pairwise_checks(false), batch_size(16), cache(NULL), checkpoint_interval(60.0), resume(false),
+      time_budget(0.0), threads(0)
+  {
+  }
+
+  /// Flag to disable the check for links that are never in collision
+  bool include_never_colliding;
+
+  /// Number of random collision checks for links that are never in collision. Upper limit with early termination
+  unsigned int trials;
+
+  /// If collisions are found between a pair of links >= this fraction, the are assumed "always" in collision
+  double min_collision_fraction;
+
+  /// Output statistics
+  bool verbose;
+
+  /// Confidence level of the discovery rate bound used for early termination
+  double termination_confidence;
+
+  /**
+   * Stop sampling for never colliding links once the probability that one more sample reveals a colliding pair that
+   * has not been seen yet is below this rate, at termination_confidence. 0 disables early termination
+   */
+  double max_discovery_rate;
+
+  /// Sequence used to sample the joint space in the always and never in collision checks
+  SamplerType sampler;
+
+  /**
+   * Seed of the sampling. With a seed >= 0 the result only depends on the robot model and the parameters, not on the
+   * number of threads. Negative values use a different random sequence on every run
+   */
+  int seed;
+
+  /**
+   * Result of a previous run, with the verdict of every pair, and the link hashes of the robot it was computed for.
+   * If both are set, pairs keep their previous verdict as long as the geometry of the two links and the joints and
+   * geometry of the links on the chain between them are unchanged. Kept pairs are not sampled again, and if all
+   * pairs are kept no sampling is done at all. Pairs missing in the previous result are computed again. Nothing is
+   * kept if previous_settings_hash differs from the settings of this request
+   */
+  const LinkPairMap *previous_link_pairs;
+  const LinkHashMap *previous_link_hashes;
+
+  /// hashDefaultCollisionsSettings() of the request of the previous run
+  boost::uint64_t previous_settings_hash;
+
+  /**
+   * Count in how many never in collision trials each pair collides. Pairs that were seen colliding keep being
+   * checked, which makes the trials slower
+   */
+  bool record_collision_frequency;
+
+  /**
+   * Disable pairs that collide in at most this fraction of the never in collision trials, with reason RARELY.
+   * Implies record_collision_frequency. 0 disables only pairs that never collided
+   */
+  double max_collision_frequency;
+
+  /**
+   * Distance in meters below which a pair that never collided still counts as a near miss and is not disabled.
+   * Pairs that are not seen colliding get distance queries in the never in collision trials, unless bounding spheres
+   * prove them farther apart than the margin. 0 disables the distance queries
+   */
+  double near_miss_margin;
+
+  /**
+   * Fraction of the never in collision trials, below 1, that focus on the pairs not decided yet. Such a trial starts
+   * from the sample in which the links of an undecided pair came closest and only perturbs the joints between the
+   * two links. Trials are only focused after the first round. 0 samples the whole joint space in every trial
+   */
+  double focus_fraction;
+
+  /// Largest perturbation of a joint in a focused trial, as a fraction of its maximum extent
+  double focus_radius;
+
+  /**
+   * Check the never in collision trials pair by pair instead of with a full self collision check. Only the pairs
+   * not decided yet are tested, with collision objects built once per link, so trials get cheaper as more pairs
+   * are seen colliding
+   */
+  bool pairwise_checks;
+
+  /**
+   * Number of trials that pair by pair checks evaluate together. All trials of a batch are sampled first, then every
+   * pair is checked in all of them, which keeps its geometry in the cache
+   */
+  unsigned int batch_size;
+
+  /**
+   * Verdicts of earlier runs, possibly of other robots. A pair is keyed by the geometry of its links, the joints and
+   * links on the kinematic chain between them and the settings of this request. Pairs found in the cache keep their
+   * verdict, the verdicts of all other pairs are added after the run
+   */
+  CollisionCache *cache;
+
+  /// File the state of the never in collision trials is saved to between rounds, empty for no checkpoints
+  std::string checkpoint_path;
+
+  /// Seconds between two checkpoints. A checkpoint is also saved when the computation is cancelled
+  double checkpoint_interval;
+
+  /**
+   * Continue the trials from the checkpoint in checkpoint_path. The checkpoint is only used if it was written for the
+   * same robot and settings, and gives the same result as an uninterrupted run if a seed is set
+   */
+  bool resume;
+
+  /**
+   * Wall clock seconds the whole computation may take, 0 for no limit. The cheap phases run first, the never in
+   * collision trials get the rest of the time, but at least one round. They stop before a round that would not
+   * finish in time, trials stays the upper limit
+   */
+  double time_budget;
+
+  /// Number of worker threads of the sampling phases, 0 for one per core
+  unsigned int threads;
+};
+
+/**
+ * \brief Timing and counters of one phase of computeDefaultCollisions()
+ */
+struct DefaultCollisionsPhaseStats
+{
+  DefaultCollisionsPhaseStats()
+    : wall_time(0.0), cpu_time(0.0), collision_checks(0), contacts(0), max_contact_map_size(0), distance_queries(0),
+      pairs_disabled(0)
+  {
+  }
+
+  /// Seconds of wall clock time
+  double wall_time;
+
+  /// Seconds of CPU time of the whole process, summed over all threads
+  double cpu_time;
+
+  /// Number of self collision checks of a full robot state, i.e. broadphase and narrowphase runs
+  unsigned long collision_checks;
+
+  /// Number of colliding link pairs reported by all collision checks
+  unsigned long contacts;
+
+  /// Largest number of colliding link pairs reported by a single collision check
+  std::size_t max_contact_map_size;
+
+  /// Number of distance queries of a single link pair
+  unsigned long distance_queries;
+
+  /// Number of link pairs disabled by the phase
+  unsigned int pairs_disabled;
+};
+
+/**
+ * \brief Performance statistics of computeDefaultCollisions()
+ */
+struct DefaultCollisionsStats
+{
+  DefaultCollisionsStats() : threads(0), max_contacts_doublings(0), barrier_wait_time(0.0)
+  {
+  }
+
+  /// Statistics of every phase, indexed by DefaultCollisionsPhase
+  DefaultCollisionsPhaseStats phases[PHASE_DONE];
+
+  /// Number of worker threads of the sampling phases
+  unsigned int threads;
+
+  /// Number of samples checked by each worker thread in the sampling phases
+  std::vector<unsigned long> thread_samples;
+
+  /// Seconds each worker thread spent checking samples. thread_samples / thread_busy_time is its sampling rate
+  std::vector<double> thread_busy_time;
+
+  /// How often the maximum number of contacts of the collision request was doubled
+  unsigned int max_contacts_doublings;
+
+  /// Seconds the worker threads spent waiting for the slowest thread of each round, summed over all threads
+  double barrier_wait_time;
+};
+
+/**
+ * \brief Outcome of computeDefaultCollisions() besides the link pairs
+ */
+struct DefaultCollisionsReport
+{
+  DefaultCollisionsReport()
+    : trials(0), stopped_early(false), last_discovery(0), discovery_rate_bound(1.0), kept_pairs(0), cancelled(false),
+      rarely_colliding(0), near_misses(0), focused_trials(0), cached_pairs(0), resumed_trials(0),
+      budget_exhausted(false), confidence_reached(0.0)
+  {
+  }
+
+  /// Number of random collision checks done for links that are never in collision
+  unsigned int trials;
+
+  /// True if the sampling stopped before the requested number of trials
+  bool stopped_early;
+
+  /// Number of trials after which the last colliding pair was seen for the first time
+  unsigned int last_discovery;
+
+  /// Upper bound, at the requested confidence, on the probability that another trial reveals a new colliding pair
+  double discovery_rate_bound;
+
+  /// Number of pairs whose verdict was taken over from the previous run
+  unsigned int kept_pairs;
+
+  /// True if the run was cancelled. Pairs are only disabled by the phases that finished, never by NEVER
+  bool cancelled;
+
+  /// Number of pairs disabled because they collided in at most max_collision_frequency of the trials
+  unsigned int rarely_colliding;
+
+  /// Number of pairs that never collided but came closer than near_miss_margin, and are therefore not disabled
+  unsigned int near_misses;
+
+  /// Number of trials that focused on undecided pairs, included in trials
+  unsigned int focused_trials;
+
+  /// Number of pairs whose verdict was taken from the cache
+  unsigned int cached_pairs;
+
+  /// Number of trials taken over from a checkpoint, included in trials
+  unsigned int resumed_trials;
+
+  /// True if the trials stopped because the time budget was used up, stopped_early is set as well
+  bool budget_exhausted;
+
+  /**
+   * Confidence that another uniform trial reveals a new colliding pair with a probability of at most
+   * max_discovery_rate. 0 if no max_discovery_rate was requested
+   */
+  double confidence_reached;
+
+  /// Timing and counters of the run
+  DefaultCollisionsStats stats;
+};
+
+/**
+ * \brief Hash of the settings of a request that change verdicts, such as the number of trials. Results of requests with
+ * different hashes cannot replace each other
+ */
+boost::uint64_t hashDefaultCollisionsSettings(const DefaultCollisionsRequest &request);
+
+/**
+ * \brief Upper bound on the probability that a trial reveals a new colliding pair, given that none was found in the
+ * last trials
+ * \param trials_without_discovery Number of consecutive trials without a new colliding pair
+ * \param confidence Confidence level of the bound
+ */
+double discoveryRateBound(unsigned int trials_without_discovery, double confidence);
+
+/**
+ * \brief Confidence that the probability of a trial revealing a new colliding pair is at most the given rate, given
+ * that none was found in the last trials. The inverse of discoveryRateBound()
+ * \param trials_without_discovery Number of consecutive trials without a new colliding pair
+ * \param rate Probability per trial
+ */
+double discoveryConfidence(unsigned int trials_without_discovery, double rate);
+
+/**
+ * \brief Generate an adjacency list of links that are always and never in collision, to speed up collision detection
+ * \param parent_scene A reference to the robot in the planning scene
+ * \param request Parameters of the computation
+ * \param progress If not NULL, updated while computing and checked for cancellation
+ * \param report If not NULL, filled with information about the run
+ * \return Adj List of unique set of pairs of links in string-based form
+ */
+LinkPairMap computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_scene,
+                                     const DefaultCollisionsRequest &request,
+                                     DefaultCollisionsProgress *progress = NULL,
+                                     DefaultCollisionsReport *report = NULL);
+
 /**
  * \brief Generate an adjacency list of links that are always and never in collision, to speed up collision detection
  * \param parent_scene A reference to the robot in the planning scene
@@ -97,6 +650,11 @@ const std::string disabledReasonToString( DisabledReason reason );
  */
 DisabledReason disabledReasonFromString( const std::string& reason );
 
+/**
+ * \brief Converts a phase of computeDefaultCollisions() into a human readable string
+ */
+const std::string defaultCollisionsPhaseToString( DefaultCollisionsPhase phase );
+
 }
 
 #endif
@@ -0,0 +1,89 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_CONTENT_HASH_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_CONTENT_HASH_
+
+#include <boost/cstdint.hpp>
+#include <string>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief 64 bit FNV-1a hash over a sequence of values. Unlike boost::hash, the result is the same in every process
+ * and library version, so it can be stored in files
+ */
+class ContentHash
+{
+public:
+  ContentHash();
+
+  /// Add raw bytes
+  ContentHash& add(const void *data, std::size_t size);
+
+  /// Add a string, including its length so that consecutive strings do not run into each other
+  ContentHash& add(const std::string &value);
+
+  /// Add a number
+  ContentHash& add(boost::uint64_t value);
+
+  /// Add a floating point number, with 0.0 and -0.0 treated as equal
+  ContentHash& add(double value);
+
+  /// Hash of all values added so far
+  boost::uint64_t value() const
+  {
+    return hash_;
+  }
+
+  /// Hash of all values added so far, as 16 hexadecimal digits
+  std::string toString() const
+  {
+    return toString(hash_);
+  }
+
+  /// Format a hash as 16 hexadecimal digits
+  static std::string toString(boost::uint64_t hash);
+
+  /// Parse a hash written by toString()
+  static bool fromString(const std::string &text, boost::uint64_t &hash);
+
+private:
+  boost::uint64_t hash_;
+};
+
+}
+
+#endif
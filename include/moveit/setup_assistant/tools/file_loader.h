@@ -48,9 +48,17 @@ bool isXacroFile(const std::string& path);
 /// load file from given path into buffer
 bool loadFileToString(std::string& buffer, const std::string& path);
 
-/// run xacro with the given args on the file, return result in buffer
+/// run xacro with the given args on the file, return result in buffer. Results are reused from the xacro cache as
+/// long as the file, the files it includes, the args, ROS_PACKAGE_PATH, the xacro version and the environment
+/// variables the files read are the same
 bool loadXacroFileToString(std::string& buffer, const std::string& path, const std::vector<std::string>& xacro_args);
 
+/// directory of the xacro cache, $ROS_HOME/xacro_cache or ~/.ros/xacro_cache unless set otherwise
+std::string getXacroCacheDirectory();
+
+/// set the directory of the xacro cache, an empty path disables the cache
+void setXacroCacheDirectory(const std::string& path);
+
 /// helper that branches between loadFileToString() and loadXacroFileToString() based on result of isXacroFile()
 bool loadXmlFileToString(std::string& buffer, const std::string& path, const std::vector<std::string>& xacro_args);
 }
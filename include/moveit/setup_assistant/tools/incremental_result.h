@@ -0,0 +1,80 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_INCREMENTAL_RESULT_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_INCREMENTAL_RESULT_
+
+#include <moveit/setup_assistant/tools/compute_default_collisions.h>
+#include <moveit/setup_assistant/tools/link_hash.h>
+#include <boost/cstdint.hpp>
+#include <string>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Everything an incremental run needs of the run before it: the link hashes of the robot, the settings and the
+ * verdict of every pair, the enabled ones included. Pairs whose links and chain did not change keep their verdict
+ * and are not sampled again
+ */
+struct IncrementalResult
+{
+  IncrementalResult() : settings_hash(0) {};
+
+  /// hashDefaultCollisionsSettings() of the request the verdicts were computed with, 0 if unknown
+  boost::uint64_t settings_hash;
+
+  /// Hashes of the links of the robot the verdicts were computed for
+  LinkHashMap link_hashes;
+
+  /// Verdict of every link pair, as returned by computeDefaultCollisions()
+  LinkPairMap link_pairs;
+};
+
+/**
+ * \brief Read a result from a YAML file written by saveIncrementalResult(). Files that only hold link hashes load
+ * without settings and verdicts, so every pair is computed again
+ * \return false if the file cannot be read
+ */
+bool loadIncrementalResult(const std::string &file_path, IncrementalResult &result);
+
+/**
+ * \brief Write a result to a YAML file. The file is replaced at once, so readers never see a partial file
+ * \return false if the file cannot be written
+ */
+bool saveIncrementalResult(const std::string &file_path, const IncrementalResult &result);
+
+}
+
+#endif
@@ -0,0 +1,214 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_JOINT_SPACE_SAMPLER_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_JOINT_SPACE_SAMPLER_
+
+#include <moveit/robot_state/robot_state.h>
+#include <boost/shared_ptr.hpp>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Sequences available for sampling the joint space of a robot
+ */
+enum SamplerType
+{
+  UNIFORM_RANDOM, // independent pseudo-random samples, RobotState::setToRandomPositions()
+  SCRAMBLED_HALTON // randomly scrambled Halton low-discrepancy sequence
+};
+
+/**
+ * \brief Generates robot states from an indexed sequence. Each index maps to one sample, so threads working on
+ * disjoint index ranges never draw the same sample. Implementations must be safe to call from multiple threads
+ *
+ * With a seed, the sample of an index only depends on the seed and the index, so the sequence is the same no matter
+ * how the indices are distributed among threads. Without a seed, random numbers come from the states themselves.
+ */
+class JointSpaceSampler
+{
+public:
+  /**
+   * \param robot_model Robot to sample
+   * \param seed Seed of the sequence, negative for a different sequence on every run
+   */
+  JointSpaceSampler(const robot_model::RobotModelConstPtr &robot_model, int seed);
+
+  virtual ~JointSpaceSampler();
+
+  /**
+   * \brief Set all joints of a state to the sample with the given index
+   * \param index Position in the sequence
+   * \param state State to modify, must belong to the robot model of the sampler
+   */
+  virtual void sample(unsigned int index, robot_state::RobotState &state) const = 0;
+
+protected:
+  /**
+   * \brief Set the given joints to uniform random positions
+   * \param joints Joints to sample
+   * \param index Position in the sequence, only used with a seed
+   * \param state State to modify
+   */
+  void sampleAtRandom(const std::vector<const robot_model::JointModel*> &joints, unsigned int index,
+                      robot_state::RobotState &state) const;
+
+  robot_model::RobotModelConstPtr robot_model_;
+
+  /// Seed of the sequence, negative if unseeded
+  int seed_;
+};
+
+typedef boost::shared_ptr<JointSpaceSampler> JointSpaceSamplerPtr;
+typedef boost::shared_ptr<const JointSpaceSampler> JointSpaceSamplerConstPtr;
+
+/**
+ * \brief Uniform pseudo-random samples, drawn with the random number generator of the state
+ */
+class UniformRandomSampler : public JointSpaceSampler
+{
+public:
+  UniformRandomSampler(const robot_model::RobotModelConstPtr &robot_model, int seed = -1);
+
+  virtual void sample(unsigned int index, robot_state::RobotState &state) const;
+};
+
+/**
+ * \brief Halton sequence over all bounded single-variable joints. Every dimension uses its own prime base, a random
+ * permutation of the non-zero digits and a random shift, which removes the correlation between the dimensions
+ * with large bases. Joints with several variables, like planar or floating joints, are sampled at random.
+ */
+class ScrambledHaltonSampler : public JointSpaceSampler
+{
+public:
+  ScrambledHaltonSampler(const robot_model::RobotModelConstPtr &robot_model, int seed = -1);
+
+  virtual void sample(unsigned int index, robot_state::RobotState &state) const;
+
+  /// Number of dimensions of the sequence
+  std::size_t getDimensions() const
+  {
+    return dimensions_.size();
+  }
+
+private:
+  /// One dimension of the sequence and the joint it is mapped to
+  struct Dimension
+  {
+    const robot_model::JointModel *joint_;
+    unsigned int base_;
+    double min_;
+    double range_;
+    double shift_;
+    std::vector<unsigned int> permutation_;
+  };
+
+  std::vector<Dimension> dimensions_;
+  std::vector<const robot_model::JointModel*> random_joints_;
+};
+
+/**
+ * \brief Samples around given robot states, changing only some of their joints. Each index picks one of the targets
+ * and moves the joints of the target to random positions near the target state. All other joints keep the values of
+ * the target state
+ */
+class FocusedSampler : public JointSpaceSampler
+{
+public:
+  /// State to sample around and the joints to perturb
+  struct Target
+  {
+    std::vector<const robot_model::JointModel*> joints_;
+    std::vector<double> positions_; // all variables of the robot
+  };
+
+  /**
+   * \param radius Largest change of a joint, as a fraction of its maximum extent
+   */
+  FocusedSampler(const robot_model::RobotModelConstPtr &robot_model, double radius, int seed = -1);
+
+  /// Replace the targets. Must not be called while other threads sample
+  void setTargets(const std::vector<Target> &targets);
+
+  /// Number of targets. sample() needs at least one
+  std::size_t getTargetCount() const
+  {
+    return targets_.size();
+  }
+
+  virtual void sample(unsigned int index, robot_state::RobotState &state) const;
+
+private:
+  double radius_;
+  std::vector<Target> targets_;
+};
+
+/**
+ * \brief Radical inverse of an index with every digit mapped through a permutation, the scrambled Halton sequence of
+ * one dimension
+ * \param index Position in the sequence
+ * \param base Base of the digits
+ * \param permutation Permutation of the digits 0 to base - 1 that keeps 0 in place
+ * \return Value in [0, 1)
+ */
+double scrambledRadicalInverse(unsigned int index, unsigned int base, const std::vector<unsigned int> &permutation);
+
+/**
+ * \brief Random permutation of the digits 0 to base - 1 that keeps 0 in place, for scrambledRadicalInverse()
+ */
+void randomDigitPermutation(unsigned int base, random_numbers::RandomNumberGenerator &rng,
+                            std::vector<unsigned int> &permutation);
+
+/**
+ * \brief Create a sampler of the given type for a robot model
+ * \param seed Seed of the sequence, negative for a different sequence on every run
+ */
+JointSpaceSamplerPtr createJointSpaceSampler(SamplerType type, const robot_model::RobotModelConstPtr &robot_model,
+                                             int seed = -1);
+
+/**
+ * \brief Converts a sampler type into a string
+ */
+std::string samplerTypeToString(SamplerType type);
+
+/**
+ * \brief Converts a string into a sampler type
+ * \return false if the string does not name a sampler type
+ */
+bool samplerTypeFromString(const std::string &name, SamplerType &type);
+
+}
+
+#endif
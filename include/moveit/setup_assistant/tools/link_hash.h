@@ -0,0 +1,79 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_LINK_HASH_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_LINK_HASH_
+
+#include <moveit/planning_scene/planning_scene.h>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <string>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Content hashes of the parts of a link that matter for self collisions
+ */
+struct LinkHash
+{
+  LinkHash() : geometry(0), joint(0) {};
+
+  /// Collision shapes, including mesh data, their origins and the padding and scale of the link
+  boost::uint64_t geometry;
+
+  /// Parent joint: parent link, type, origin, axis, limits and mimic settings
+  boost::uint64_t joint;
+};
+
+/**
+ * \brief Hashes of all links of a robot, by link name
+ */
+typedef std::map<std::string, LinkHash> LinkHashMap;
+
+/**
+ * \brief Hash the geometry and parent joint of every link of a robot
+ * \param scene A reference to the robot in the planning scene, for the link padding and scale
+ * \param hashes Filled with one entry per link
+ */
+void computeLinkHashes(const planning_scene::PlanningScene &scene, LinkHashMap &hashes);
+
+/**
+ * \brief Hashes of a link, zero hashes if the link is not in the map
+ */
+const LinkHash& findLinkHash(const LinkHashMap &hashes, const std::string &link_name);
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_LINK_PAIR_CHECKER_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_LINK_PAIR_CHECKER_
+
+#include <moveit/planning_scene/planning_scene.h>
+#include <fcl/collision_object.h>
+#include <boost/shared_ptr.hpp>
+#include <string>
+#include <vector>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Checks single pairs of links for collision in a batch of states, without a broadphase over all links of
+ * the robot.
+ *
+ * Every link gets FCL collision objects for its shapes once, with the padding and scale of the scene. The first time
+ * a link is used in a batch, the transforms and bounding boxes of its shapes are computed for all states of the
+ * batch and stored shape by shape, so checking one pair in consecutive states reads consecutive memory. Only shapes
+ * with overlapping bounding boxes go through the narrowphase. Collision objects are modified by checks, so every
+ * thread needs its own checker.
+ */
+class LinkPairChecker
+{
+public:
+  /**
+   * \param scene Planning scene whose collision robot defines the padding and scale of the links
+   * \param link_names Links that can be checked, their position in the list is their id
+   */
+  LinkPairChecker(const planning_scene::PlanningScene &scene, const std::vector<std::string> &link_names);
+
+  /**
+   * \brief Start checking a new batch of states
+   * \param states States with updated collision body transforms, must stay valid until the next call
+   * \param count Number of states of the batch, the first ones of states
+   */
+  void setStates(const std::vector<robot_state::RobotState> &states, std::size_t count);
+
+  /**
+   * \brief Check whether two links collide in a state of the current batch
+   * \param link_a Id of the first link
+   * \param link_b Id of the second link
+   * \param state Position of the state in the batch
+   */
+  bool checkPair(int link_a, int link_b, std::size_t state);
+
+  /**
+   * \brief Distance of the shapes of two links in any state, independent of the current batch
+   * \param link_a Id of the first link
+   * \param link_b Id of the second link
+   * \param state State with updated collision body transforms
+   * \return Smallest distance of two shapes, 0 if they touch, infinity if a link has no shapes
+   */
+  double distancePair(int link_a, int link_b, const robot_state::RobotState &state);
+
+private:
+  /// Collision objects of the shapes of one link and their placement in the states of the batch
+  struct LinkObjects
+  {
+    const robot_model::LinkModel *link_;
+    std::vector<boost::shared_ptr<fcl::CollisionObject> > objects_;
+    std::vector<std::size_t> shape_indices_; // index of the shape of every object in the link
+    std::vector<fcl::Transform3f> transforms_; // object by object, the states of the batch after each other
+    std::vector<fcl::AABB> aabbs_; // same layout as transforms_
+    unsigned int batch_count_; // number of the batch the transforms belong to
+  };
+
+  /// Compute the transforms and bounding boxes of a link for the current batch, if they are not there yet
+  void updateLink(LinkObjects &link);
+
+  /// Move the collision objects of a link to their place in a state, outside of the batch
+  void placeLink(LinkObjects &link, const robot_state::RobotState &state);
+
+  std::vector<LinkObjects> links_;
+  const std::vector<robot_state::RobotState> *states_;
+  std::size_t state_count_; // states in the current batch
+  unsigned int batch_count_;
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_WORKER_POOL_
+#define MOVEIT_MOVEIT_SETUP_ASSISTANT_TOOLS_WORKER_POOL_
+
+#include <boost/exception_ptr.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+#include <deque>
+
+namespace moveit_setup_assistant
+{
+
+/**
+ * \brief Process-wide pool of worker threads for the parallel phases of the setup assistant tools.
+ *
+ * Threads are created when first needed and live until the process ends, so repeated computations neither pay for
+ * creating threads nor lose what the threads keep in thread-local storage. Work is submitted through a TaskGroup and
+ * waited for as a whole. An exception thrown by a task is passed on to the thread waiting for its group.
+ */
+class WorkerPool : private boost::noncopyable
+{
+public:
+  /**
+   * \brief Tasks that are submitted to the pool together and waited for together
+   */
+  class TaskGroup : private boost::noncopyable
+  {
+  public:
+    explicit TaskGroup(WorkerPool &pool = WorkerPool::getInstance());
+
+    /// Waits for all tasks of the group, exceptions of the tasks are dropped
+    ~TaskGroup();
+
+    /// Queue a task, it runs on one of the threads of the pool
+    void submit(const boost::function<void ()> &task);
+
+    /**
+     * \brief Wait until all tasks of the group are done. The calling thread runs queued tasks of this group
+     * meanwhile, so a task running on the pool may wait for a group of its own. Tasks of other groups are left to the
+     * pool, they may take much longer than the tasks waited for. Rethrows the first exception thrown by a task
+     */
+    void wait();
+
+    /**
+     * \brief Wait until all tasks of the group are done, but at most the given time. No tasks are run by the calling
+     * thread, so a GUI thread can keep handling events in between. Rethrows the first exception thrown by a task once
+     * all are done
+     * \return true if all tasks are done
+     */
+    bool timedWait(const boost::posix_time::time_duration &timeout);
+
+  private:
+    friend class WorkerPool;
+
+    /// Wait for all tasks and help with the queued ones of this group, without rethrowing. The lock must be held
+    void waitDone(boost::unique_lock<boost::mutex> &lock);
+
+    /// Rethrow the first exception of a task and forget it. The lock must be held and is released
+    void rethrowError(boost::unique_lock<boost::mutex> &lock);
+
+    WorkerPool &pool_;
+    unsigned int pending_; // tasks submitted but not finished, guarded by the mutex of the pool
+    boost::exception_ptr error_; // first exception thrown by a task, guarded by the mutex of the pool
+  };
+
+  /// The pool shared by the whole process
+  static WorkerPool& getInstance();
+
+  /// Stops and joins all threads
+  ~WorkerPool();
+
+  /// Create threads until the pool has at least the given number
+  void reserve(unsigned int threads);
+
+  /// Number of threads of the pool
+  unsigned int getThreadCount() const;
+
+private:
+  /// Queued work and the group it belongs to
+  struct Task
+  {
+    boost::function<void ()> function_;
+    TaskGroup *group_;
+  };
+
+  WorkerPool();
+
+  /// Main loop of every thread of the pool
+  void workerLoop();
+
+  /// Remove a task from the queue, run it with the mutex unlocked, then mark it done. The lock must be held
+  void runTask(boost::unique_lock<boost::mutex> &lock, std::deque<Task>::iterator task_it);
+
+  mutable boost::mutex mutex_; // guards all members below and the pending counts of the groups
+  boost::condition_variable work_available_;
+  boost::condition_variable task_done_;
+  std::deque<Task> queue_;
+  boost::thread_group threads_;
+  unsigned int thread_count_;
+  bool stopping_;
+};
+
+}
+
+#endif
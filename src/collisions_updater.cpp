@@ -37,11 +37,218 @@
 #include <ros/ros.h>
 #include <moveit/setup_assistant/tools/moveit_config_data.h>
 #include <moveit/setup_assistant/tools/file_loader.h>
+#include <moveit/setup_assistant/tools/incremental_result.h>
+#include <moveit/setup_assistant/tools/collision_cache.h>
+#include <moveit/setup_assistant/tools/worker_pool.h>
+
+#include <boost/filesystem.hpp>
 
 #include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <yaml-cpp/yaml.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <cstdio>
+#include <signal.h>
+#include <unistd.h>
 
 namespace po = boost::program_options;
 
+// Progress of the running computation, cancelled on SIGINT
+static moveit_setup_assistant::DefaultCollisionsProgress *g_progress = NULL;
+
+// Set on SIGINT, the computations of a batch are cancelled by the main thread
+static volatile sig_atomic_t g_interrupted = 0;
+
+static void siginthandler(int param)
+{
+  g_interrupted = 1;
+  if (g_progress)
+    g_progress->cancel();
+}
+
+// How the progress of a computation is shown
+enum ProgressMode { PROGRESS_NONE, PROGRESS_LOG, PROGRESS_TTY };
+
+// Prints the progress of a computation from its own thread at a fixed interval. It only reads the atomics of the
+// progress, so the workers are never held up
+class ProgressReporter : private boost::noncopyable
+{
+public:
+  ProgressReporter(const moveit_setup_assistant::DefaultCollisionsProgress &progress, ProgressMode mode,
+                   double interval)
+    : progress_(progress), mode_(mode), interval_(interval), stopping_(false), last_samples_(0), last_time_(0.0),
+      peak_rate_(0.0)
+  {
+  }
+
+  ~ProgressReporter()
+  {
+    stop();
+  }
+
+  void start()
+  {
+    if (mode_ != PROGRESS_NONE && !thread_.joinable())
+      thread_ = boost::thread(&ProgressReporter::run, this);
+  }
+
+  // Print the last update and the throughput of the whole computation
+  void stop()
+  {
+    if (!thread_.joinable())
+      return;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_all();
+    thread_.join();
+
+    printUpdate();
+    if (mode_ == PROGRESS_TTY)
+      std::printf("\n");
+    const double elapsed = progress_.getElapsedTime();
+    const unsigned int samples = progress_.getSamplesChecked();
+    ROS_INFO("Checked %u samples in %.1f s, %.0f samples/s on average, %.0f samples/s at most", samples, elapsed,
+             elapsed > 0.0 ? samples / elapsed : 0.0, peak_rate_);
+  }
+
+private:
+  void run()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (!stopping_)
+    {
+      condition_.timed_wait(lock, boost::posix_time::milliseconds(static_cast<long>(interval_ * 1000.0)));
+      if (!stopping_)
+        printUpdate();
+    }
+  }
+
+  void printUpdate()
+  {
+    // Throughput since the last update, over all phases
+    const double now = progress_.getElapsedTime();
+    const unsigned int samples = progress_.getSamplesChecked();
+    const double rate = now > last_time_ ? (samples - last_samples_) / (now - last_time_) : 0.0;
+    last_samples_ = samples;
+    last_time_ = now;
+    peak_rate_ = std::max(peak_rate_, rate);
+
+    char eta[32] = "unknown";
+    const double remaining = progress_.getRemainingTime();
+    if (remaining >= 0.0)
+      std::snprintf(eta, sizeof(eta), "%d:%02d", static_cast<int>(remaining) / 60, static_cast<int>(remaining) % 60);
+
+    char line[256];
+    std::snprintf(line, sizeof(line), "%3u%% %s: %u/%u samples, %.0f samples/s, %zu/%zu pairs resolved, ETA %s",
+                  progress_.getPercent(),
+                  moveit_setup_assistant::defaultCollisionsPhaseToString(progress_.getPhase()).c_str(),
+                  progress_.getSamplesDone(), progress_.getSamplesTotal(), rate, progress_.getPairsResolved(),
+                  progress_.getPairsTotal(), eta);
+
+    // A terminal shows one line that is overwritten, a log gets one line per update
+    if (mode_ == PROGRESS_TTY)
+    {
+      std::printf("\r%s\033[K", line);
+      std::fflush(stdout);
+    }
+    else
+      ROS_INFO("%s", line);
+  }
+
+  const moveit_setup_assistant::DefaultCollisionsProgress &progress_;
+  const ProgressMode mode_;
+  const double interval_; // seconds
+  boost::thread thread_;
+  boost::mutex mutex_; // guards stopping_
+  boost::condition_variable condition_;
+  bool stopping_;
+  unsigned int last_samples_; // members below are only used by the reporting thread until it is joined
+  double last_time_;
+  double peak_rate_;
+};
+
+// Reasons of the disabled pairs of an SRDF, keys ordered alphabetically
+typedef std::map<std::pair<std::string, std::string>, std::string> DisabledReasonMap;
+
+// A disabled pair that differs between the SRDF before and after the update
+struct PairChange
+{
+  std::string link1;
+  std::string link2;
+  std::string old_reason; // empty if the pair was added
+  std::string new_reason; // empty if the pair was removed
+};
+
+// Disabled pairs added, removed and with a new reason
+struct DisabledPairsDiff
+{
+  bool empty() const
+  {
+    return added.empty() && removed.empty() && changed.empty();
+  }
+  std::vector<PairChange> added;
+  std::vector<PairChange> removed;
+  std::vector<PairChange> changed;
+};
+
+// Settings of a batch run that are the same for every package
+struct BatchSettings
+{
+  moveit_setup_assistant::DefaultCollisionsRequest request;
+  std::vector<std::string> xacro_args;
+  bool keep_old;
+  bool dry_run;
+  size_t skip_mask;
+};
+
+// Outcome of updating one package of a batch
+struct PackageSummary
+{
+  PackageSummary()
+    : success(false), cancelled(false), trials(0), pairs_disabled(0), pairs_added(0), pairs_removed(0),
+      pairs_changed(0), srdf_written(false), wall_time(0.0)
+  {
+  }
+  std::string package;
+  bool success;
+  bool cancelled;
+  std::string error; // empty on success
+  unsigned int trials;
+  unsigned int pairs_disabled;
+  unsigned int pairs_added;
+  unsigned int pairs_removed;
+  unsigned int pairs_changed; // reason changed
+  bool srdf_written; // false if the content was the same or in a dry run
+  double wall_time; // seconds
+};
+
+// Packages of a batch and the state shared by the tasks that update them
+struct BatchRun
+{
+  BatchRun(const std::vector<std::string> &packages, const BatchSettings &settings)
+    : packages_(packages), settings_(settings), summaries_(packages.size()), next_(0)
+  {
+  }
+  const std::vector<std::string> &packages_;
+  const BatchSettings &settings_;
+  std::vector<PackageSummary> summaries_; // indexed like packages_, every entry written by one task only
+  boost::atomic<unsigned int> next_; // index of the next package to take
+  boost::mutex mutex_; // guards running_
+  std::set<moveit_setup_assistant::DefaultCollisionsProgress*> running_; // cancelled on SIGINT
+};
+
 bool loadSetupAssistantConfig(moveit_setup_assistant::MoveItConfigData &config_data, const std::string &pkg_path)
 {
   if (!config_data.setPackagePath(pkg_path))
@@ -70,8 +277,7 @@ bool loadSetupAssistantConfig(moveit_setup_assistant::MoveItConfigData &config_d
   return true;
 }
 
-bool setup(moveit_setup_assistant::MoveItConfigData &config_data, bool keep_old,
-           const std::vector<std::string> &xacro_args)
+bool setup(moveit_setup_assistant::MoveItConfigData &config_data, const std::vector<std::string> &xacro_args)
 {
   std::string urdf_string;
   if (!moveit_setup_assistant::loadXmlFileToString(urdf_string, config_data.urdf_path_, xacro_args))
@@ -97,19 +303,473 @@ bool setup(moveit_setup_assistant::MoveItConfigData &config_data, bool keep_old,
     return false;
   }
 
-  if (!keep_old)
-    config_data.srdf_->disabled_collisions_.clear();
+  return true;
+}
+
+void getDisabledReasons(const moveit_setup_assistant::SRDFWriter &srdf, DisabledReasonMap &reasons)
+{
+  for (std::vector<srdf::Model::DisabledCollision>::const_iterator pair_it = srdf.disabled_collisions_.begin();
+       pair_it != srdf.disabled_collisions_.end(); ++pair_it)
+    reasons[std::make_pair(std::min(pair_it->link1_, pair_it->link2_),
+                           std::max(pair_it->link1_, pair_it->link2_))] = pair_it->reason_;
+}
+
+void diffDisabledPairs(const DisabledReasonMap &old_reasons, const DisabledReasonMap &new_reasons,
+                       DisabledPairsDiff &diff)
+{
+  // Both maps are sorted, walk them side by side
+  DisabledReasonMap::const_iterator old_it = old_reasons.begin();
+  DisabledReasonMap::const_iterator new_it = new_reasons.begin();
+  while (old_it != old_reasons.end() || new_it != new_reasons.end())
+  {
+    PairChange change;
+    if (new_it == new_reasons.end() || (old_it != old_reasons.end() && old_it->first < new_it->first))
+    {
+      change.link1 = old_it->first.first;
+      change.link2 = old_it->first.second;
+      change.old_reason = old_it->second;
+      diff.removed.push_back(change);
+      ++old_it;
+    }
+    else if (old_it == old_reasons.end() || new_it->first < old_it->first)
+    {
+      change.link1 = new_it->first.first;
+      change.link2 = new_it->first.second;
+      change.new_reason = new_it->second;
+      diff.added.push_back(change);
+      ++new_it;
+    }
+    else
+    {
+      if (old_it->second != new_it->second)
+      {
+        change.link1 = old_it->first.first;
+        change.link2 = old_it->first.second;
+        change.old_reason = old_it->second;
+        change.new_reason = new_it->second;
+        diff.changed.push_back(change);
+      }
+      ++old_it;
+      ++new_it;
+    }
+  }
+}
+
+void printDiff(const DisabledPairsDiff &diff)
+{
+  if (diff.empty())
+  {
+    ROS_INFO("Disabled collisions unchanged");
+    return;
+  }
+  ROS_INFO("Disabled collisions: %zu added, %zu removed, %zu with a new reason", diff.added.size(),
+           diff.removed.size(), diff.changed.size());
+  for (std::size_t i = 0 ; i < diff.added.size() ; ++i)
+    ROS_INFO("  + %s - %s: %s", diff.added[i].link1.c_str(), diff.added[i].link2.c_str(),
+             diff.added[i].new_reason.c_str());
+  for (std::size_t i = 0 ; i < diff.removed.size() ; ++i)
+    ROS_INFO("  - %s - %s: %s", diff.removed[i].link1.c_str(), diff.removed[i].link2.c_str(),
+             diff.removed[i].old_reason.c_str());
+  for (std::size_t i = 0 ; i < diff.changed.size() ; ++i)
+    ROS_INFO("  ~ %s - %s: %s -> %s", diff.changed[i].link1.c_str(), diff.changed[i].link2.c_str(),
+             diff.changed[i].old_reason.c_str(), diff.changed[i].new_reason.c_str());
+}
+
+bool writeSRDFIfChanged(moveit_setup_assistant::SRDFWriter &srdf, const std::string &path, bool &written)
+{
+  // Written from the same string that is compared, so an unchanged update leaves the file alone the next time
+  const std::string srdf_string = srdf.getSRDFString();
+  written = false;
+
+  std::ifstream input_stream(path.c_str());
+  if (input_stream.good())
+  {
+    std::stringstream buffer;
+    buffer << input_stream.rdbuf();
+    if (buffer.str() == srdf_string)
+      return true;
+  }
+  input_stream.close();
+
+  // Write next to the target and rename, so that a failed write never leaves a truncated SRDF
+  const std::string temp_path = path + ".tmp";
+  std::ofstream output_stream(temp_path.c_str(), std::ios_base::trunc);
+  if (!output_stream.good())
+  {
+    ROS_ERROR_STREAM("Unable to open file for writing " << temp_path);
+    return false;
+  }
+  output_stream << srdf_string;
+  output_stream.close();
+  if (output_stream.fail())
+  {
+    ROS_ERROR_STREAM("Could not write SRDF to " << temp_path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+  {
+    ROS_ERROR_STREAM("Could not replace SRDF " << path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  written = true;
+  return true;
+}
+
+moveit_setup_assistant::LinkPairMap compute(moveit_setup_assistant::MoveItConfigData &config_data,
+                                            const moveit_setup_assistant::DefaultCollisionsRequest &request,
+                                            moveit_setup_assistant::DefaultCollisionsReport &report,
+                                            ProgressMode progress_mode, double progress_interval)
+{
+  moveit_setup_assistant::DefaultCollisionsProgress collision_progress;
+  ProgressReporter reporter(collision_progress, progress_mode, progress_interval);
+  reporter.start();
+
+  // Ctrl-C stops the computation, a cancelled result is not written
+  g_progress = &collision_progress;
+  signal(SIGINT, siginthandler);
+  moveit_setup_assistant::LinkPairMap link_pairs =
+    moveit_setup_assistant::computeDefaultCollisions(config_data.getPlanningScene(), request, &collision_progress,
+                                                     &report);
+  signal(SIGINT, SIG_DFL);
+  g_progress = NULL;
+  reporter.stop();
+
+  return link_pairs;
+}
+
+void setEmitterFormat(const std::string &path, YAML::Emitter &emitter)
+{
+  // JSON is written as YAML in flow style with quoted strings
+  if (boost::algorithm::ends_with(path, ".json"))
+  {
+    emitter.SetMapFormat(YAML::Flow);
+    emitter.SetSeqFormat(YAML::Flow);
+    emitter.SetStringFormat(YAML::DoubleQuoted);
+  }
+}
+
+bool writeEmitter(const std::string &path, const YAML::Emitter &emitter)
+{
+  if (path == "-")
+  {
+    std::cout << emitter.c_str() << std::endl;
+    return true;
+  }
+
+  std::ofstream output_stream(path.c_str(), std::ios_base::trunc);
+  if (!output_stream.good())
+  {
+    ROS_ERROR_STREAM("Unable to open file for writing " << path);
+    return false;
+  }
+  output_stream << emitter.c_str() << std::endl;
+
+  return true;
+}
+
+bool writeStats(const std::string &path, const moveit_setup_assistant::DefaultCollisionsReport &report)
+{
+  // Keys of the phases, indexed by DefaultCollisionsPhase
+  static const char *phase_keys[] = { "setup", "adjacent", "default", "unreachable", "always", "never" };
+
+  const moveit_setup_assistant::DefaultCollisionsStats &stats = report.stats;
+
+  YAML::Emitter emitter;
+  setEmitterFormat(path, emitter);
+
+  emitter << YAML::BeginMap;
+  emitter << YAML::Key << "trials" << YAML::Value << report.trials;
+  emitter << YAML::Key << "stopped_early" << YAML::Value << report.stopped_early;
+  emitter << YAML::Key << "cancelled" << YAML::Value << report.cancelled;
+  emitter << YAML::Key << "near_misses" << YAML::Value << report.near_misses;
+  emitter << YAML::Key << "focused_trials" << YAML::Value << report.focused_trials;
+  emitter << YAML::Key << "cached_pairs" << YAML::Value << report.cached_pairs;
+  emitter << YAML::Key << "resumed_trials" << YAML::Value << report.resumed_trials;
+  emitter << YAML::Key << "budget_exhausted" << YAML::Value << report.budget_exhausted;
+  emitter << YAML::Key << "confidence_reached" << YAML::Value << report.confidence_reached;
+  emitter << YAML::Key << "threads" << YAML::Value << stats.threads;
+  emitter << YAML::Key << "max_contacts_doublings" << YAML::Value << stats.max_contacts_doublings;
+  emitter << YAML::Key << "barrier_wait_time" << YAML::Value << stats.barrier_wait_time;
+
+  emitter << YAML::Key << "phases" << YAML::Value << YAML::BeginMap;
+  for (int phase = moveit_setup_assistant::PHASE_ADJACENT ; phase < moveit_setup_assistant::PHASE_DONE ; ++phase)
+  {
+    const moveit_setup_assistant::DefaultCollisionsPhaseStats &phase_stats = stats.phases[phase];
+    emitter << YAML::Key << phase_keys[phase] << YAML::Value << YAML::BeginMap;
+    emitter << YAML::Key << "wall_time" << YAML::Value << phase_stats.wall_time;
+    emitter << YAML::Key << "cpu_time" << YAML::Value << phase_stats.cpu_time;
+    emitter << YAML::Key << "collision_checks" << YAML::Value << phase_stats.collision_checks;
+    emitter << YAML::Key << "contacts" << YAML::Value << phase_stats.contacts;
+    emitter << YAML::Key << "max_contact_map_size" << YAML::Value << phase_stats.max_contact_map_size;
+    emitter << YAML::Key << "distance_queries" << YAML::Value << phase_stats.distance_queries;
+    emitter << YAML::Key << "pairs_disabled" << YAML::Value << phase_stats.pairs_disabled;
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndMap;
+
+  emitter << YAML::Key << "worker_threads" << YAML::Value << YAML::BeginSeq;
+  for (std::size_t i = 0 ; i < stats.thread_samples.size() ; ++i)
+  {
+    emitter << YAML::BeginMap;
+    emitter << YAML::Key << "samples" << YAML::Value << stats.thread_samples[i];
+    emitter << YAML::Key << "busy_time" << YAML::Value << stats.thread_busy_time[i];
+    emitter << YAML::Key << "samples_per_second" << YAML::Value
+            << (stats.thread_busy_time[i] > 0.0 ? stats.thread_samples[i] / stats.thread_busy_time[i] : 0.0);
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndSeq;
+  emitter << YAML::EndMap;
+
+  return writeEmitter(path, emitter);
+}
+
+bool writeBatchStats(const std::string &path, const std::vector<PackageSummary> &summaries)
+{
+  YAML::Emitter emitter;
+  setEmitterFormat(path, emitter);
+
+  emitter << YAML::BeginMap;
+  emitter << YAML::Key << "packages" << YAML::Value << YAML::BeginSeq;
+  for (std::size_t i = 0 ; i < summaries.size() ; ++i)
+  {
+    emitter << YAML::BeginMap;
+    emitter << YAML::Key << "package" << YAML::Value << summaries[i].package;
+    emitter << YAML::Key << "success" << YAML::Value << summaries[i].success;
+    emitter << YAML::Key << "cancelled" << YAML::Value << summaries[i].cancelled;
+    emitter << YAML::Key << "error" << YAML::Value << summaries[i].error;
+    emitter << YAML::Key << "trials" << YAML::Value << summaries[i].trials;
+    emitter << YAML::Key << "pairs_disabled" << YAML::Value << summaries[i].pairs_disabled;
+    emitter << YAML::Key << "pairs_added" << YAML::Value << summaries[i].pairs_added;
+    emitter << YAML::Key << "pairs_removed" << YAML::Value << summaries[i].pairs_removed;
+    emitter << YAML::Key << "pairs_changed" << YAML::Value << summaries[i].pairs_changed;
+    emitter << YAML::Key << "srdf_written" << YAML::Value << summaries[i].srdf_written;
+    emitter << YAML::Key << "wall_time" << YAML::Value << summaries[i].wall_time;
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndSeq;
+  emitter << YAML::EndMap;
+
+  return writeEmitter(path, emitter);
+}
+
+void emitPairChanges(YAML::Emitter &emitter, const char *key, const std::vector<PairChange> &changes)
+{
+  emitter << YAML::Key << key << YAML::Value << YAML::BeginSeq;
+  for (std::size_t i = 0 ; i < changes.size() ; ++i)
+  {
+    emitter << YAML::BeginMap;
+    emitter << YAML::Key << "link1" << YAML::Value << changes[i].link1;
+    emitter << YAML::Key << "link2" << YAML::Value << changes[i].link2;
+    if (!changes[i].old_reason.empty())
+      emitter << YAML::Key << "old_reason" << YAML::Value << changes[i].old_reason;
+    if (!changes[i].new_reason.empty())
+      emitter << YAML::Key << "reason" << YAML::Value << changes[i].new_reason;
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndSeq;
+}
+
+bool writeReport(const std::string &path, const DisabledPairsDiff &diff, bool srdf_written)
+{
+  YAML::Emitter emitter;
+  setEmitterFormat(path, emitter);
 
+  emitter << YAML::BeginMap;
+  emitter << YAML::Key << "changed" << YAML::Value << !diff.empty();
+  emitter << YAML::Key << "srdf_written" << YAML::Value << srdf_written;
+  emitPairChanges(emitter, "added", diff.added);
+  emitPairChanges(emitter, "removed", diff.removed);
+  emitPairChanges(emitter, "reason_changed", diff.changed);
+  emitter << YAML::EndMap;
+
+  return writeEmitter(path, emitter);
+}
+
+void printCollisionFrequencies(const moveit_setup_assistant::LinkPairMap &link_pairs)
+{
+  // Enabled pairs, most frequently colliding first
+  std::vector<std::pair<double, const moveit_setup_assistant::LinkPairMap::key_type*> > pairs;
+  for (moveit_setup_assistant::LinkPairMap::const_iterator pair_it = link_pairs.begin();
+       pair_it != link_pairs.end(); ++pair_it)
+  {
+    if (!pair_it->second.disable_check && pair_it->second.collision_frequency >= 0.0)
+      pairs.push_back(std::make_pair(pair_it->second.collision_frequency, &pair_it->first));
+  }
+  std::sort(pairs.begin(), pairs.end());
+
+  ROS_INFO("Sometimes in collision:");
+  for (std::size_t i = pairs.size() ; i-- > 0 ;)
+    ROS_INFO("  %s - %s: p=%.3g%%", pairs[i].second->first.c_str(), pairs[i].second->second.c_str(),
+             100.0 * pairs[i].first);
+}
+
+bool readManifest(const std::string &path, std::vector<std::string> &packages)
+{
+  std::ifstream input_stream(path.c_str());
+  if (!input_stream.good())
+  {
+    ROS_ERROR_STREAM("Unable to open manifest " << path);
+    return false;
+  }
+
+  // One package path or name per line, empty lines and lines starting with # are skipped
+  std::string line;
+  while (std::getline(input_stream, line))
+  {
+    boost::algorithm::trim(line);
+    if (!line.empty() && line[0] != '#')
+      packages.push_back(line);
+  }
+
+  if (packages.empty())
+  {
+    ROS_ERROR_STREAM("Manifest " << path << " lists no packages");
+    return false;
+  }
   return true;
 }
 
-moveit_setup_assistant::LinkPairMap compute(moveit_setup_assistant::MoveItConfigData &config_data, uint32_t trials,
-                                            double min_collision_fraction, bool verbose)
+void updatePackage(BatchRun &run, std::size_t index)
 {
-  // TODO: spin thread and print progess if verbose
-  unsigned int collision_progress;
-  return moveit_setup_assistant::computeDefaultCollisions(config_data.getPlanningScene(), &collision_progress,
-                                                          trials > 0, trials, min_collision_fraction, verbose);
+  PackageSummary &summary = run.summaries_[index];
+  summary.package = run.packages_[index];
+  ros::WallTime start_time = ros::WallTime::now();
+
+  moveit_setup_assistant::MoveItConfigData config_data;
+  if (!loadSetupAssistantConfig(config_data, summary.package) || !setup(config_data, run.settings_.xacro_args))
+  {
+    summary.error = "could not load the package";
+    return;
+  }
+  DisabledReasonMap old_reasons;
+  getDisabledReasons(*config_data.srdf_, old_reasons);
+  if (!run.settings_.keep_old)
+    config_data.srdf_->disabled_collisions_.clear();
+
+  // Registered for SIGINT before the check, so a signal in between is not missed
+  moveit_setup_assistant::DefaultCollisionsProgress collision_progress;
+  {
+    boost::mutex::scoped_lock lock(run.mutex_);
+    run.running_.insert(&collision_progress);
+  }
+  if (g_interrupted)
+    collision_progress.cancel();
+
+  moveit_setup_assistant::DefaultCollisionsReport report;
+  moveit_setup_assistant::LinkPairMap link_pairs =
+    moveit_setup_assistant::computeDefaultCollisions(config_data.getPlanningScene(), run.settings_.request,
+                                                     &collision_progress, &report);
+  {
+    boost::mutex::scoped_lock lock(run.mutex_);
+    run.running_.erase(&collision_progress);
+  }
+
+  summary.trials = report.trials;
+  summary.wall_time = (ros::WallTime::now() - start_time).toSec();
+  if (report.cancelled)
+  {
+    summary.cancelled = true;
+    summary.error = "cancelled";
+    return;
+  }
+
+  for (moveit_setup_assistant::LinkPairMap::const_iterator pair_it = link_pairs.begin() ;
+       pair_it != link_pairs.end() ; ++pair_it)
+    summary.pairs_disabled += pair_it->second.disable_check;
+
+  config_data.setCollisionLinkPairs(link_pairs, run.settings_.skip_mask);
+
+  DisabledReasonMap new_reasons;
+  getDisabledReasons(*config_data.srdf_, new_reasons);
+  DisabledPairsDiff diff;
+  diffDisabledPairs(old_reasons, new_reasons, diff);
+  summary.pairs_added = diff.added.size();
+  summary.pairs_removed = diff.removed.size();
+  summary.pairs_changed = diff.changed.size();
+
+  if (!run.settings_.dry_run && !writeSRDFIfChanged(*config_data.srdf_, config_data.srdf_path_, summary.srdf_written))
+  {
+    summary.error = "could not write " + config_data.srdf_path_;
+    return;
+  }
+  summary.success = true;
+}
+
+void updatePackagesTask(BatchRun *run)
+{
+  // Take packages until none are left, so every task stays busy however long a package takes
+  while (!g_interrupted)
+  {
+    const unsigned int index = run->next_++;
+    if (index >= run->packages_.size())
+      break;
+    updatePackage(*run, index);
+  }
+}
+
+bool updatePackages(const std::vector<std::string> &packages, const BatchSettings &settings, unsigned int jobs,
+                    std::vector<PackageSummary> &summaries)
+{
+  // The packages and their sampling threads share the threads of the pool, which limits the total load
+  const unsigned int threads = settings.request.threads > 0 ? settings.request.threads :
+                               std::max(1u, boost::thread::hardware_concurrency());
+  jobs = std::min<unsigned int>(std::max(1u, jobs), packages.size());
+  moveit_setup_assistant::WorkerPool::getInstance().reserve(std::max(jobs, threads));
+
+  BatchRun run(packages, settings);
+  signal(SIGINT, siginthandler);
+  {
+    moveit_setup_assistant::WorkerPool::TaskGroup group;
+    for (unsigned int i = 0 ; i < jobs ; ++i)
+      group.submit(boost::bind(&updatePackagesTask, &run));
+
+    // Ctrl-C cancels the packages that are running, the others are not started
+    while (!group.timedWait(boost::posix_time::milliseconds(100)))
+    {
+      if (!g_interrupted)
+        continue;
+      boost::mutex::scoped_lock lock(run.mutex_);
+      for (std::set<moveit_setup_assistant::DefaultCollisionsProgress*>::iterator it = run.running_.begin() ;
+           it != run.running_.end() ; ++it)
+        (*it)->cancel();
+    }
+  }
+  signal(SIGINT, SIG_DFL);
+
+  summaries = run.summaries_;
+  bool success = true;
+  for (std::size_t i = 0 ; i < summaries.size() ; ++i)
+  {
+    if (summaries[i].package.empty()) // never started
+    {
+      summaries[i].package = packages[i];
+      summaries[i].cancelled = true;
+      summaries[i].error = "not started";
+    }
+    success &= summaries[i].success;
+  }
+  return success;
+}
+
+void printSummary(const std::vector<PackageSummary> &summaries)
+{
+  unsigned int num_updated = 0;
+  ROS_INFO("Packages:");
+  for (std::size_t i = 0 ; i < summaries.size() ; ++i)
+  {
+    const PackageSummary &summary = summaries[i];
+    if (summary.success)
+      ROS_INFO("  %s: %u pairs disabled (+%u -%u ~%u), %u trials, %.1f s%s", summary.package.c_str(),
+               summary.pairs_disabled, summary.pairs_added, summary.pairs_removed, summary.pairs_changed,
+               summary.trials, summary.wall_time, summary.srdf_written ? ", SRDF written" : "");
+    else
+      ROS_ERROR("  %s: %s", summary.package.c_str(), summary.error.c_str());
+    num_updated += summary.success;
+  }
+  ROS_INFO("%u of %zu packages updated", num_updated, summaries.size());
 }
 
 int main(int argc, char *argv[])
@@ -120,12 +780,61 @@ int main(int argc, char *argv[])
 
   std::string output_path;
 
+  std::string incremental_path;
+  std::string cache_path;
+
+  std::size_t cache_size = moveit_setup_assistant::CollisionCache::DEFAULT_MAX_ENTRIES;
+
+  std::string manifest_path;
+
+  std::string xacro_cache_path;
+
+  unsigned int jobs = std::max(1u, boost::thread::hardware_concurrency());
+
+  std::string checkpoint_path;
+
+  double checkpoint_interval = 60.0;
+
+  bool resume = false;
+
+  std::string stats_path;
+
+  std::string report_path;
+
+  bool dry_run = false;
+
   bool include_default = false, include_always = false, keep_old = false, verbose = false;
 
+  bool collision_frequency = false;
+
+  bool pairwise_checks = false;
+
+  unsigned int batch_size = 16;
+
+  double max_collision_frequency = 0.0;
+
+  double near_miss_margin = 0.0;
+
+  double focus_fraction = 0.0, focus_radius = 0.1;
+
   double min_collision_fraction = 1.0;
 
   uint32_t never_trials = 0;
 
+  double max_discovery_rate = 0.0, confidence = 0.95;
+
+  double time_budget = 0.0;
+
+  unsigned int threads = 0;
+
+  std::string sampler = "random";
+
+  std::string progress = "auto";
+
+  double progress_interval = 0.0;
+
+  int seed = -1;
+
   po::options_description desc("Allowed options");
   desc.add_options()
     ("help", "show help")
@@ -135,15 +844,42 @@ int main(int argc, char *argv[])
     ("output", po::value(&output_path), "output path for SRDF")
 
     ("xacro-args", po::value<std::vector<std::string> >()->composing(), "additional arguments for xacro")
+    ("xacro-cache", po::value(&xacro_cache_path), "directory of the cache of xacro results, ~/.ros/xacro_cache by default. Empty to disable it")
 
     ("default", po::bool_switch(&include_default),  "disable default colliding pairs")
     ("always", po::bool_switch(&include_always),  "disable always colliding pairs")
 
     ("keep", po::bool_switch(&keep_old),  "keep disabled link from SRDF")
-    ("verbose", po::bool_switch(&verbose),  "verbose output")
+    ("verbose", po::bool_switch(&verbose),  "verbose output, shows the progress")
+    ("progress", po::value(&progress),  "how the progress is shown: tty (one updated line), log (one line per update), auto (tty on a terminal, log otherwise, only with --verbose) or none")
+    ("progress-interval", po::value(&progress_interval),  "seconds between two progress updates, 1 for tty and 10 for log by default")
 
     ("trials", po::value(&never_trials),  "number of trials for searching never colliding pairs")
     ("min-collision-fraction", po::value(&min_collision_fraction),  "fraction of small sample size to determine links that are alwas colliding")
+    ("max-discovery-rate", po::value(&max_discovery_rate),  "stop the trials early once the probability of finding another colliding pair per trial is below this rate")
+    ("confidence", po::value(&confidence),  "confidence level of the bound used by --max-discovery-rate")
+    ("time-budget", po::value(&time_budget),  "seconds the computation may take. The trials use the time left after the other checks, up to --trials if given. --max-discovery-rate defaults to 0.0001 and --focus-fraction to 0.25. The confidence reached for the rate is reported")
+    ("sampler", po::value(&sampler),  "joint space sampler: random or halton")
+    ("collision-frequency", po::bool_switch(&collision_frequency),  "count how often each pair collides in the trials and print the pairs that are sometimes in collision")
+    ("max-collision-frequency", po::value(&max_collision_frequency),  "also disable pairs that collide in at most this fraction of the trials")
+    ("near-miss-margin", po::value(&near_miss_margin),  "measure distances in the trials and keep pairs enabled that came closer than this margin in meters")
+    ("focus-fraction", po::value(&focus_fraction),  "fraction of the trials that only perturb the joints between the links of pairs not decided yet")
+    ("focus-radius", po::value(&focus_radius),  "largest perturbation of a joint in focused trials, as a fraction of its range")
+    ("pairwise-checks", po::bool_switch(&pairwise_checks),  "check the trials pair by pair, only for the pairs not seen colliding yet")
+    ("batch-size", po::value(&batch_size),  "number of trials checked together with --pairwise-checks")
+    ("threads", po::value(&threads),  "number of worker threads, one per core by default")
+    ("seed", po::value(&seed),  "seed for reproducible results, independent of the number of threads")
+    ("stats", po::value(&stats_path),  "write timing and counters to this file, as JSON if it ends with .json, as YAML otherwise. - for stdout")
+    ("incremental", po::value(&incremental_path),  "file with the link hashes and pair verdicts of the previous run, only pairs affected by changed links are computed again. Updated afterwards")
+    ("checkpoint", po::value(&checkpoint_path),  "file the state of the never colliding trials is saved to, periodically and when interrupted. Removed after a complete run")
+    ("checkpoint-interval", po::value(&checkpoint_interval),  "seconds between two checkpoints")
+    ("resume", po::bool_switch(&resume),  "continue the trials from --checkpoint, gives the result of an uninterrupted run with the same --seed")
+    ("manifest", po::value(&manifest_path),  "file listing one config package per line, all of them are updated in this process")
+    ("jobs", po::value(&jobs),  "number of packages of --manifest updated at the same time, all share --threads")
+    ("dry-run", po::bool_switch(&dry_run),  "compute and print the changes of the disabled pairs without writing the SRDF, the cache or the --incremental file. --report, --stats and --checkpoint are still written. Exits with 2 if the pairs changed, 0 otherwise")
+    ("report", po::value(&report_path),  "write the added, removed and changed disabled pairs to this file, as JSON if it ends with .json, as YAML otherwise. - for stdout")
+    ("cache", po::value(&cache_path),  "file with the verdicts of earlier runs, shared between robots. Pairs with the same links and chain between them are not computed again. Updated afterwards")
+    ("cache-size", po::value(&cache_size),  "most verdicts kept in --cache, the ones used least recently are dropped. 0 for no limit")
   ;
 
   po::positional_options_description pos_desc;
@@ -159,6 +895,128 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  moveit_setup_assistant::DefaultCollisionsRequest request;
+  if (!moveit_setup_assistant::samplerTypeFromString(sampler, request.sampler))
+  {
+    ROS_ERROR_STREAM("Unknown sampler '" << sampler << "'");
+    return 1;
+  }
+  // With a budget, the trials run until the time is up or the discovery rate is low enough
+  if (time_budget > 0.0)
+  {
+    if (!vm.count("trials"))
+      never_trials = std::numeric_limits<uint32_t>::max();
+    if (!vm.count("max-discovery-rate"))
+      max_discovery_rate = 1e-4;
+    // Like the GUI, spend part of the trials on the pairs not decided yet, where the time helps most
+    if (!vm.count("focus-fraction"))
+      focus_fraction = 0.25;
+  }
+  ProgressMode progress_mode = PROGRESS_NONE;
+  if (progress == "tty")
+    progress_mode = PROGRESS_TTY;
+  else if (progress == "log")
+    progress_mode = PROGRESS_LOG;
+  else if (progress == "auto")
+  {
+    if (verbose)
+      progress_mode = isatty(STDOUT_FILENO) ? PROGRESS_TTY : PROGRESS_LOG;
+  }
+  else if (progress != "none")
+  {
+    ROS_ERROR_STREAM("Unknown progress mode '" << progress << "'");
+    return 1;
+  }
+  if (progress_interval <= 0.0)
+    progress_interval = progress_mode == PROGRESS_TTY ? 1.0 : 10.0;
+  if (focus_fraction < 0.0 || focus_fraction >= 1.0)
+  {
+    ROS_ERROR_STREAM("--focus-fraction must be at least 0 and below 1");
+    return 1;
+  }
+  request.include_never_colliding = never_trials > 0;
+  request.trials = never_trials;
+  request.min_collision_fraction = min_collision_fraction;
+  request.verbose = verbose;
+  request.max_discovery_rate = max_discovery_rate;
+  request.termination_confidence = confidence;
+  request.seed = seed;
+  request.record_collision_frequency = collision_frequency;
+  request.max_collision_frequency = max_collision_frequency;
+  request.near_miss_margin = near_miss_margin;
+  request.focus_fraction = focus_fraction;
+  request.focus_radius = focus_radius;
+  request.pairwise_checks = pairwise_checks;
+  request.batch_size = batch_size;
+  request.time_budget = time_budget;
+  request.threads = threads;
+
+  if (vm.count("xacro-cache"))
+    moveit_setup_assistant::setXacroCacheDirectory(xacro_cache_path);
+
+  std::vector<std::string> xacro_args;
+  if (vm.count("xacro-args"))
+    xacro_args = vm["xacro-args"].as<std::vector<std::string> >();
+
+  size_t skip_mask = 0;
+  if (!include_default)
+    skip_mask |= (1 << moveit_setup_assistant::DEFAULT);
+  if (!include_always)
+    skip_mask |= (1 << moveit_setup_assistant::ALWAYS);
+
+  moveit_setup_assistant::CollisionCache cache;
+  cache.setMaxEntries(cache_size);
+  if (!cache_path.empty() && boost::filesystem::exists(cache_path) && !cache.load(cache_path))
+  {
+    ROS_ERROR_STREAM("Could not load collision cache from '" << cache_path << "'");
+    return 1;
+  }
+  if (!cache_path.empty())
+    request.cache = &cache;
+
+  // Many packages in one process. They share the worker pool, the cache and the lookup of the template path
+  if (!manifest_path.empty())
+  {
+    if (!config_pkg_path.empty() || !urdf_path.empty() || !srdf_path.empty() || !output_path.empty() ||
+        !incremental_path.empty() || !checkpoint_path.empty() || !report_path.empty())
+    {
+      ROS_ERROR_STREAM("--manifest cannot be combined with --config-pkg, --urdf, --srdf, --output, --incremental, "
+                       "--checkpoint or --report");
+      return 1;
+    }
+
+    std::vector<std::string> packages;
+    if (!readManifest(manifest_path, packages))
+      return 1;
+
+    BatchSettings settings;
+    settings.request = request;
+    settings.xacro_args = xacro_args;
+    settings.keep_old = keep_old;
+    settings.dry_run = dry_run;
+    settings.skip_mask = skip_mask;
+
+    std::vector<PackageSummary> summaries;
+    bool success = updatePackages(packages, settings, jobs, summaries);
+    printSummary(summaries);
+    if (!stats_path.empty() && !writeBatchStats(stats_path, summaries))
+      return 1;
+
+    if (!cache_path.empty() && !dry_run && !g_interrupted && !cache.save(cache_path))
+    {
+      ROS_ERROR_STREAM("Could not save collision cache to '" << cache_path << "'");
+      return 1;
+    }
+    if (!success)
+      return 1;
+    for (std::size_t i = 0 ; dry_run && i < summaries.size() ; ++i)
+    {
+      if (summaries[i].pairs_added + summaries[i].pairs_removed + summaries[i].pairs_changed > 0)
+        return 2;
+    }
+    return 0;
+  }
+
   moveit_setup_assistant::MoveItConfigData config_data;
 
   if (!config_pkg_path.empty())
@@ -186,27 +1044,119 @@ int main(int argc, char *argv[])
   if (!srdf_path.empty())
     config_data.srdf_path_ = srdf_path;
 
-  std::vector<std::string> xacro_args;
-  if (vm.count("xacro-args"))
-    xacro_args = vm["xacro-args"].as<std::vector<std::string> >();
-
-  if (!setup(config_data, keep_old, xacro_args))
+  if (!setup(config_data, xacro_args))
   {
     ROS_ERROR_STREAM("Could not setup updater");
     return 1;
   }
 
-  moveit_setup_assistant::LinkPairMap link_pairs = compute(config_data, never_trials, min_collision_fraction, verbose);
+  // The verdict of every pair of the previous run, with the link hashes it was computed for
+  moveit_setup_assistant::IncrementalResult previous;
+  bool incremental = false;
+  if (!incremental_path.empty() && boost::filesystem::exists(incremental_path))
+  {
+    if (!moveit_setup_assistant::loadIncrementalResult(incremental_path, previous))
+    {
+      ROS_ERROR_STREAM("Could not load the previous result from '" << incremental_path << "'");
+      return 1;
+    }
+    incremental = true;
+  }
+  else if (!incremental_path.empty())
+  {
+    ROS_INFO_STREAM("No previous result at '" << incremental_path << "', computing all link pairs");
+  }
+
+  if (resume && checkpoint_path.empty())
+  {
+    ROS_ERROR_STREAM("--resume needs a --checkpoint file");
+    return 1;
+  }
+  if (resume && !boost::filesystem::exists(checkpoint_path))
+  {
+    ROS_INFO_STREAM("No checkpoint at '" << checkpoint_path << "', starting the trials from the beginning");
+    resume = false;
+  }
+
+  // Compared to the result, to report the changes and decide whether anything changed
+  DisabledReasonMap old_reasons;
+  getDisabledReasons(*config_data.srdf_, old_reasons);
 
-  size_t skip_mask = 0;
-  if (!include_default)
-    skip_mask |= (1 << moveit_setup_assistant::DEFAULT);
-  if (!include_always)
-    skip_mask |= (1 << moveit_setup_assistant::ALWAYS);
+  if (!keep_old)
+    config_data.srdf_->disabled_collisions_.clear();
+
+  if (incremental)
+  {
+    request.previous_link_pairs = &previous.link_pairs;
+    request.previous_link_hashes = &previous.link_hashes;
+    request.previous_settings_hash = previous.settings_hash;
+  }
+  request.checkpoint_path = checkpoint_path;
+  request.checkpoint_interval = checkpoint_interval;
+  request.resume = resume;
+
+  moveit_setup_assistant::DefaultCollisionsReport report;
+  moveit_setup_assistant::LinkPairMap link_pairs =
+    compute(config_data, request, report, progress_mode, progress_interval);
+  if (!stats_path.empty() && !writeStats(stats_path, report))
+    return 1;
+
+  if (report.cancelled)
+  {
+    if (!checkpoint_path.empty())
+      ROS_ERROR_STREAM("Computation cancelled, SRDF not written. Continue with --resume");
+    else
+      ROS_ERROR_STREAM("Computation cancelled, SRDF not written");
+    return 1;
+  }
+
+  if (collision_frequency)
+    printCollisionFrequencies(link_pairs);
 
   config_data.setCollisionLinkPairs(link_pairs, skip_mask);
 
-  config_data.srdf_->writeSRDF(output_path.empty() ? config_data.srdf_path_ : output_path);
+  DisabledReasonMap new_reasons;
+  getDisabledReasons(*config_data.srdf_, new_reasons);
+  DisabledPairsDiff diff;
+  diffDisabledPairs(old_reasons, new_reasons, diff);
+  printDiff(diff);
+
+  // A dry run leaves the SRDF, the cache and the incremental result as they are, the exit code tells whether the
+  // SRDF would change
+  bool srdf_written = false;
+  if (!dry_run &&
+      !writeSRDFIfChanged(*config_data.srdf_, output_path.empty() ? config_data.srdf_path_ : output_path,
+                          srdf_written))
+    return 1;
+  if (!report_path.empty() && !writeReport(report_path, diff, srdf_written))
+    return 1;
+  if (dry_run)
+    return diff.empty() ? 0 : 2;
+
+  // The trials of a run stopped by the time budget fall short of the settings in the file, the previous result stays
+  if (!incremental_path.empty() && report.budget_exhausted)
+  {
+    ROS_INFO_STREAM("Time budget used up, '" << incremental_path << "' not updated");
+  }
+  else if (!incremental_path.empty())
+  {
+    moveit_setup_assistant::IncrementalResult result;
+    result.settings_hash = moveit_setup_assistant::hashDefaultCollisionsSettings(request);
+    moveit_setup_assistant::computeLinkHashes(*config_data.getPlanningScene(), result.link_hashes);
+    result.link_pairs.swap(link_pairs);
+    if (!moveit_setup_assistant::saveIncrementalResult(incremental_path, result))
+      return 1;
+  }
+
+  if (!cache_path.empty() && !cache.save(cache_path))
+  {
+    ROS_ERROR_STREAM("Could not save collision cache to '" << cache_path << "'");
+    return 1;
+  }
+
+  // The SRDF holds the result now, a later run must not continue this one
+  if (!checkpoint_path.empty() && boost::filesystem::exists(checkpoint_path))
+    boost::filesystem::remove(checkpoint_path);
 
   return 0;
 }
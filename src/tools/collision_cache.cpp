@@ -0,0 +1,285 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/collision_cache.h>
+#include <ros/console.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace moveit_setup_assistant
+{
+
+// Start of every cache file and the version of the record layout
+static const char CACHE_MAGIC[8] = { 'M', 'S', 'A', 'C', 'A', 'C', 'H', 'E' };
+static const boost::uint32_t CACHE_VERSION = 3;
+
+// ******************************************************************************************
+// Static Prototypes
+// ******************************************************************************************
+
+/**
+ * \brief Write the lowest bytes of a number, least significant first
+ */
+static void writeNumber(std::ostream &out, boost::uint64_t value, int bytes);
+
+/**
+ * \brief Read a number written by writeNumber()
+ */
+static boost::uint64_t readNumber(std::istream &in, int bytes);
+
+/**
+ * \brief Bit pattern of a float, for writing it in a fixed byte order
+ */
+static boost::uint32_t floatBits(float value);
+
+/**
+ * \brief Float of a bit pattern returned by floatBits()
+ */
+static float bitsFloat(boost::uint32_t bits);
+
+/**
+ * \brief Reason of a record in a file of the given version. Before version 3, UNREACHABLE came before USER and
+ * NOT_DISABLED
+ */
+static boost::uint64_t upgradeReason(boost::uint64_t reason, boost::uint64_t version);
+
+// ******************************************************************************************
+// Verdicts of link pairs stored in a local file
+// ******************************************************************************************
+const std::size_t CollisionCache::DEFAULT_MAX_ENTRIES;
+
+CollisionCache::CollisionCache() : generation_(0), max_entries_(DEFAULT_MAX_ENTRIES)
+{
+}
+
+bool CollisionCache::load(const std::string &file_path)
+{
+  entries_.clear();
+  generation_ = 0;
+
+  std::ifstream in(file_path.c_str(), std::ios::binary);
+  if (!in.good())
+  {
+    ROS_ERROR_STREAM("Unable to open collision cache " << file_path);
+    return false;
+  }
+
+  char magic[sizeof(CACHE_MAGIC)];
+  in.read(magic, sizeof(magic));
+  const boost::uint64_t version = in.good() ? readNumber(in, 4) : 0;
+  if (!in.good() || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version < 1 || version > CACHE_VERSION)
+  {
+    ROS_ERROR_STREAM("File " << file_path << " is not a collision cache of this version");
+    return false;
+  }
+
+  // Entries of version 1 count as used by the run before this one
+  const boost::uint32_t generation = version >= 2 ? readNumber(in, 4) : 0;
+  const boost::uint64_t count = readNumber(in, 4);
+  Entry entry;
+  entry.generation = generation;
+  for (boost::uint64_t i = 0 ; i < count && in.good() ; ++i)
+  {
+    const boost::uint64_t key = readNumber(in, 8);
+    const boost::uint64_t reason = upgradeReason(readNumber(in, 1), version);
+    entry.data.disable_check = readNumber(in, 1) != 0;
+    entry.data.collision_frequency = bitsFloat(readNumber(in, 4));
+    entry.data.min_distance = bitsFloat(readNumber(in, 4));
+    if (version >= 2)
+      entry.generation = readNumber(in, 4);
+    if (reason > RARELY)
+    {
+      ROS_ERROR_STREAM("Collision cache " << file_path << " has an invalid reason " << reason);
+      entries_.clear();
+      return false;
+    }
+    entry.data.reason = (DisabledReason)reason;
+    entries_.insert(entries_.end(), std::make_pair(key, entry));
+  }
+
+  if (!in.good())
+  {
+    ROS_ERROR_STREAM("Collision cache " << file_path << " is truncated");
+    entries_.clear();
+    return false;
+  }
+
+  generation_ = generation + 1;
+  return true;
+}
+
+bool CollisionCache::save(const std::string &file_path) const
+{
+  // Beyond the limit, entries older than the cut are dropped, and of the ones at the cut as many as still fit
+  std::size_t count = entries_.size();
+  boost::uint32_t cut = 0;
+  std::size_t room_at_cut = count;
+  if (max_entries_ > 0 && count > max_entries_)
+  {
+    std::vector<boost::uint32_t> generations;
+    generations.reserve(count);
+    for (std::map<boost::uint64_t, Entry>::const_iterator it = entries_.begin() ; it != entries_.end() ; ++it)
+      generations.push_back(it->second.generation);
+    std::nth_element(generations.begin(), generations.begin() + (count - max_entries_), generations.end());
+    cut = generations[count - max_entries_];
+    room_at_cut = max_entries_;
+    for (std::size_t i = count - max_entries_ + 1 ; i < count ; ++i)
+      if (generations[i] > cut)
+        --room_at_cut;
+    count = max_entries_;
+  }
+
+  // Write next to the target and rename, so that runs sharing the cache never read a partial file
+  const std::string temp_path = file_path + ".tmp";
+  {
+    std::ofstream out(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    writeNumber(out, CACHE_VERSION, 4);
+    writeNumber(out, generation_, 4);
+    writeNumber(out, count, 4);
+    for (std::map<boost::uint64_t, Entry>::const_iterator it = entries_.begin() ; it != entries_.end() ; ++it)
+    {
+      if (it->second.generation < cut || (it->second.generation == cut && room_at_cut == 0))
+        continue;
+      if (it->second.generation == cut)
+        --room_at_cut;
+      writeNumber(out, it->first, 8);
+      writeNumber(out, it->second.data.reason, 1);
+      writeNumber(out, it->second.data.disable_check, 1);
+      writeNumber(out, floatBits(it->second.data.collision_frequency), 4);
+      writeNumber(out, floatBits(it->second.data.min_distance), 4);
+      writeNumber(out, it->second.generation, 4);
+    }
+
+    if (!out.good())
+    {
+      ROS_ERROR_STREAM("Unable to write collision cache " << temp_path);
+      return false;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), file_path.c_str()) != 0)
+  {
+    ROS_ERROR_STREAM("Unable to replace collision cache " << file_path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool CollisionCache::lookup(boost::uint64_t key, LinkPairData &data)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  std::map<boost::uint64_t, Entry>::iterator it = entries_.find(key);
+  if (it == entries_.end())
+    return false;
+
+  it->second.generation = generation_;
+  data = it->second.data;
+  return true;
+}
+
+void CollisionCache::store(boost::uint64_t key, const LinkPairData &data)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Entry &entry = entries_[key];
+  entry.data = data;
+  entry.generation = generation_;
+}
+
+// ******************************************************************************************
+// Write the lowest bytes of a number, least significant first
+// ******************************************************************************************
+void writeNumber(std::ostream &out, boost::uint64_t value, int bytes)
+{
+  for (int i = 0 ; i < bytes ; ++i)
+    out.put((char)(value >> (8 * i)));
+}
+
+// ******************************************************************************************
+// Read a number written by writeNumber()
+// ******************************************************************************************
+boost::uint64_t readNumber(std::istream &in, int bytes)
+{
+  boost::uint64_t value = 0;
+  for (int i = 0 ; i < bytes ; ++i)
+    value |= (boost::uint64_t)(unsigned char)in.get() << (8 * i);
+  return value;
+}
+
+// ******************************************************************************************
+// Bit pattern of a float
+// ******************************************************************************************
+boost::uint32_t floatBits(float value)
+{
+  boost::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// ******************************************************************************************
+// Float of a bit pattern
+// ******************************************************************************************
+float bitsFloat(boost::uint32_t bits)
+{
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// ******************************************************************************************
+// Reason of a record in a file of an older version
+// ******************************************************************************************
+boost::uint64_t upgradeReason(boost::uint64_t reason, boost::uint64_t version)
+{
+  if (version >= 3)
+    return reason;
+  switch (reason)
+  {
+    case 4:
+      return UNREACHABLE;
+    case 5:
+      return USER;
+    case 6:
+      return NOT_DISABLED;
+    default:
+      return reason;
+  }
+}
+
+}
@@ -0,0 +1,254 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/collision_checkpoint.h>
+#include <ros/console.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace moveit_setup_assistant
+{
+
+// Start of every checkpoint file and the version of its layout
+static const char CHECKPOINT_MAGIC[8] = { 'M', 'S', 'A', 'C', 'H', 'K', 'P', 'T' };
+static const boost::uint32_t CHECKPOINT_VERSION = 1;
+
+// ******************************************************************************************
+// Static Prototypes
+// ******************************************************************************************
+
+/**
+ * \brief Write a number in the byte order of the machine
+ */
+template <typename T>
+static void writeValue(std::ostream &out, T value);
+
+/**
+ * \brief Read a number written by writeValue()
+ */
+template <typename T>
+static T readValue(std::istream &in);
+
+/**
+ * \brief Write the size of a vector followed by its elements
+ */
+template <typename T>
+static void writeVector(std::ostream &out, const std::vector<T> &values);
+
+/**
+ * \brief Read a vector written by writeVector()
+ * \return false if the size is implausible for the rest of the file
+ */
+template <typename T>
+static bool readVector(std::istream &in, std::vector<T> &values);
+
+/**
+ * \brief Write the size of a bitset followed by its blocks
+ */
+static void writeBitset(std::ostream &out, const boost::dynamic_bitset<> &bits);
+
+/**
+ * \brief Read a bitset written by writeBitset()
+ */
+static bool readBitset(std::istream &in, boost::dynamic_bitset<> &bits);
+
+// ******************************************************************************************
+// Read a checkpoint
+// ******************************************************************************************
+bool loadCollisionCheckpoint(const std::string &file_path, CollisionCheckpoint &checkpoint)
+{
+  std::ifstream in(file_path.c_str(), std::ios::binary);
+  if (!in.good())
+  {
+    ROS_ERROR_STREAM("Unable to open checkpoint " << file_path);
+    return false;
+  }
+
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  in.read(magic, sizeof(magic));
+  if (!in.good() || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+      readValue<boost::uint32_t>(in) != CHECKPOINT_VERSION)
+  {
+    ROS_ERROR_STREAM("File " << file_path << " is not a checkpoint of this version");
+    return false;
+  }
+
+  checkpoint.key = readValue<boost::uint64_t>(in);
+  checkpoint.trials_done = readValue<boost::uint32_t>(in);
+  checkpoint.focused_trials = readValue<boost::uint32_t>(in);
+  checkpoint.last_discovery = readValue<boost::uint32_t>(in);
+
+  bool ok = readBitset(in, checkpoint.seen_colliding) && readBitset(in, checkpoint.near_pairs) &&
+            readVector(in, checkpoint.collision_count) && readVector(in, checkpoint.min_distance) &&
+            readVector(in, checkpoint.closest_distance) && readVector(in, checkpoint.closest_trial);
+
+  checkpoint.closest_positions.resize(ok ? checkpoint.closest_distance.size() : 0);
+  for (std::size_t i = 0 ; i < checkpoint.closest_positions.size() && ok ; ++i)
+    ok = readVector(in, checkpoint.closest_positions[i]);
+
+  if (!ok || !in.good())
+  {
+    ROS_ERROR_STREAM("Checkpoint " << file_path << " is truncated");
+    return false;
+  }
+
+  return true;
+}
+
+// ******************************************************************************************
+// Write a checkpoint
+// ******************************************************************************************
+bool saveCollisionCheckpoint(const std::string &file_path, const CollisionCheckpoint &checkpoint)
+{
+  // Write next to the target and rename, so that a crash while writing keeps the previous checkpoint
+  const std::string temp_path = file_path + ".tmp";
+  {
+    std::ofstream out(temp_path.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeValue<boost::uint32_t>(out, CHECKPOINT_VERSION);
+    writeValue<boost::uint64_t>(out, checkpoint.key);
+    writeValue<boost::uint32_t>(out, checkpoint.trials_done);
+    writeValue<boost::uint32_t>(out, checkpoint.focused_trials);
+    writeValue<boost::uint32_t>(out, checkpoint.last_discovery);
+    writeBitset(out, checkpoint.seen_colliding);
+    writeBitset(out, checkpoint.near_pairs);
+    writeVector(out, checkpoint.collision_count);
+    writeVector(out, checkpoint.min_distance);
+    writeVector(out, checkpoint.closest_distance);
+    writeVector(out, checkpoint.closest_trial);
+    for (std::size_t i = 0 ; i < checkpoint.closest_distance.size() ; ++i)
+      writeVector(out, i < checkpoint.closest_positions.size() ? checkpoint.closest_positions[i] :
+                  std::vector<double>());
+
+    if (!out.good())
+    {
+      ROS_ERROR_STREAM("Unable to write checkpoint " << temp_path);
+      return false;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), file_path.c_str()) != 0)
+  {
+    ROS_ERROR_STREAM("Unable to replace checkpoint " << file_path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+// ******************************************************************************************
+// Write a number in the byte order of the machine
+// ******************************************************************************************
+template <typename T>
+void writeValue(std::ostream &out, T value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// ******************************************************************************************
+// Read a number written by writeValue()
+// ******************************************************************************************
+template <typename T>
+T readValue(std::istream &in)
+{
+  T value = T();
+  in.read(reinterpret_cast<char*>(&value), sizeof(value));
+  return value;
+}
+
+// ******************************************************************************************
+// Write the size of a vector followed by its elements
+// ******************************************************************************************
+template <typename T>
+void writeVector(std::ostream &out, const std::vector<T> &values)
+{
+  writeValue<boost::uint64_t>(out, values.size());
+  if (!values.empty())
+    out.write(reinterpret_cast<const char*>(&values[0]), values.size() * sizeof(T));
+}
+
+// ******************************************************************************************
+// Read a vector written by writeVector()
+// ******************************************************************************************
+template <typename T>
+bool readVector(std::istream &in, std::vector<T> &values)
+{
+  const boost::uint64_t size = readValue<boost::uint64_t>(in);
+
+  // A corrupt size must not allocate more than the file can hold
+  const std::streampos position = in.tellg();
+  in.seekg(0, std::ios::end);
+  const std::streamoff remaining = in.tellg() - position;
+  in.seekg(position);
+  if (!in.good() || size > (boost::uint64_t)remaining / sizeof(T))
+    return false;
+
+  values.resize(size);
+  if (!values.empty())
+    in.read(reinterpret_cast<char*>(&values[0]), values.size() * sizeof(T));
+  return in.good();
+}
+
+// ******************************************************************************************
+// Write the size of a bitset followed by its blocks
+// ******************************************************************************************
+void writeBitset(std::ostream &out, const boost::dynamic_bitset<> &bits)
+{
+  std::vector<boost::dynamic_bitset<>::block_type> blocks(bits.num_blocks());
+  boost::to_block_range(bits, blocks.begin());
+  writeValue<boost::uint64_t>(out, bits.size());
+  writeVector(out, blocks);
+}
+
+// ******************************************************************************************
+// Read a bitset written by writeBitset()
+// ******************************************************************************************
+bool readBitset(std::istream &in, boost::dynamic_bitset<> &bits)
+{
+  const boost::uint64_t size = readValue<boost::uint64_t>(in);
+  std::vector<boost::dynamic_bitset<>::block_type> blocks;
+  if (!readVector(in, blocks))
+    return false;
+
+  bits.clear();
+  bits.append(blocks.begin(), blocks.end());
+  if (size > bits.size())
+    return false;
+  bits.resize(size);
+  return true;
+}
+
+}
@@ -35,13 +35,26 @@
 /* Author: Dave Coleman */
 
 #include <moveit/setup_assistant/tools/compute_default_collisions.h>
+#include <moveit/setup_assistant/tools/collision_cache.h>
+#include <moveit/setup_assistant/tools/collision_checkpoint.h>
+#include <moveit/setup_assistant/tools/content_hash.h>
+#include <moveit/setup_assistant/tools/link_pair_checker.h>
+#include <moveit/setup_assistant/tools/worker_pool.h>
+#include <geometric_shapes/shapes.h>
 #include <boost/math/special_functions/binomial.hpp> // for statistics at end
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/scoped_array.hpp>
 #include <tinyxml.h>
 #include <boost/lexical_cast.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/assign.hpp>
 #include <ros/console.h>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <limits>
 
 namespace moveit_setup_assistant
 {
@@ -57,7 +70,19 @@ const boost::unordered_map<DisabledReason, std::string> reasonsToString = boost:
   ( ADJACENT, "Adjacent" )
   ( ALWAYS, "Always" )
   ( USER, "User" )
-  ( NOT_DISABLED, "Not Disabled");
+  ( NOT_DISABLED, "Not Disabled")
+  ( UNREACHABLE, "Unreachable" )
+  ( RARELY, "Rarely" );
+
+// Boost mapping of phases of the computation to strings
+const boost::unordered_map<DefaultCollisionsPhase, std::string> phasesToString = boost::assign::map_list_of
+  ( PHASE_SETUP, "Setup" )
+  ( PHASE_ADJACENT, "Adjacent links" )
+  ( PHASE_DEFAULT, "Default collisions" )
+  ( PHASE_UNREACHABLE, "Out of reach" )
+  ( PHASE_ALWAYS, "Always in collision" )
+  ( PHASE_NEVER, "Never in collision" )
+  ( PHASE_DONE, "Done" );
 
 const boost::unordered_map< std::string, DisabledReason> reasonsFromString = boost::assign::map_list_of
   ( "Never", NEVER )
@@ -65,40 +90,211 @@ const boost::unordered_map< std::string, DisabledReason> reasonsFromString = boo
   ( "Adjacent", ADJACENT )
   ( "Always", ALWAYS )
   ( "User", USER )
-  ( "Not Disabled", NOT_DISABLED );
+  ( "Not Disabled", NOT_DISABLED )
+  ( "Unreachable", UNREACHABLE )
+  ( "Rarely", RARELY );
 
 
-// Unique set of pairs of links in string-based form
-typedef std::set<std::pair<std::string, std::string> > StringPairSet;
+// Unique set of pairs of links, one bit per pair index of a LinkPairMatrix
+typedef boost::dynamic_bitset<> PairBitset;
+
+// Pair index and trial number at which a thread saw the pair colliding for the first time
+typedef std::vector<std::pair<std::size_t, unsigned int> > PairDiscoveries;
+
+// Counters of one worker thread in one round, reduced after all threads joined
+struct ThreadStats
+{
+  ThreadStats() : samples(0), contacts(0), max_contact_map_size(0), distance_queries(0), busy_time(0.0)
+  {
+  }
+  unsigned int samples;
+  unsigned long contacts;
+  std::size_t max_contact_map_size;
+  unsigned long distance_queries;
+  double busy_time; // seconds
+};
+
+// Measures the wall clock and CPU time of a phase
+class PhaseTimer
+{
+public:
+  explicit PhaseTimer(DefaultCollisionsPhaseStats &stats);
+
+  // Add the time since construction to the phase
+  void stop();
+
+private:
+  DefaultCollisionsPhaseStats &stats_;
+  ros::WallTime wall_start_;
+  double cpu_start_;
+};
+
+// Link pairs that get distance queries in the never in collision check, shared read-only by all threads
+struct NearMissChecks
+{
+  NearMissChecks() : margin(0.0)
+  {
+  }
+  double margin; // pairs closer than this are near misses
+  std::vector<const robot_model::LinkModel*> links; // indexed by link id
+  std::vector<double> link_radius; // indexed by link id, negative if the geometry is unbounded
+  std::vector<std::size_t> pairs; // pair indices of the candidates
+};
+
+// Trials of a round, handed out to the threads batch by batch as they finish their previous batch. Threads that hit
+// expensive contacts just take fewer batches. Each thread gets its batches in increasing order, so the trials it
+// checks stay in sequence order
+class TrialQueue : private boost::noncopyable
+{
+public:
+  TrialQueue(unsigned int first, unsigned int count) : first_(first), count_(count), taken_(0)
+  {
+  }
+
+  // Take up to max_count of the remaining trials, false once all are taken
+  bool take(unsigned int max_count, unsigned int &first, unsigned int &count)
+  {
+    const unsigned int offset = taken_.fetch_add(max_count); // offsets stay far below the overflow
+    if (offset >= count_)
+      return false;
+    first = first_ + offset;
+    count = std::min(max_count, count_ - offset);
+    return true;
+  }
+
+private:
+  const unsigned int first_;
+  const unsigned int count_;
+  boost::atomic<unsigned int> taken_;
+};
+
+// Robot states and collision results of one thread of a phase, kept between its rounds. Owned by the phase, so the
+// states and the robot model they point to are released when the phase is done
+struct ThreadScratch
+{
+  std::vector<robot_state::RobotState> states;
+  collision_detection::CollisionResult result;
+};
+
+// Sampled state in which the links of a pair came closest, the start of focused trials on the pair
+struct ClosestState
+{
+  ClosestState() : distance(std::numeric_limits<double>::infinity()), trial(0)
+  {
+  }
+  double distance; // between the link origins
+  unsigned int trial;
+  std::vector<double> positions; // all variables of the robot
+};
+
+// Undecided pairs the never in collision check focuses on, shared read-only by all threads
+struct FocusChecks
+{
+  FocusChecks() : fraction(0.0), sampler(NULL)
+  {
+  }
+  double fraction; // of the trials that use the focused sampler
+  std::vector<const robot_model::LinkModel*> links; // indexed by link id
+  std::vector<std::size_t> pairs; // pair indices of the undecided pairs, tracked in every trial
+  const JointSpaceSampler *sampler; // samples around the closest states, NULL in rounds without targets
+};
 
 // Struct for passing parameters to threads, for cleaner code
 struct ThreadComputation
 {
-  ThreadComputation(planning_scene::PlanningScene &scene, const collision_detection::CollisionRequest &req,
-                    int thread_id, int num_trials, StringPairSet *links_seen_colliding, boost::mutex *lock,
-                    unsigned int *progress)
+  ThreadComputation(const planning_scene::PlanningScene &scene, const collision_detection::CollisionRequest &req,
+                    const LinkPairMatrix &link_pairs, const JointSpaceSampler &sampler, int thread_id,
+                    TrialQueue *trials, const PairBitset *links_seen_colliding,
+                    PairDiscoveries *discoveries, std::vector<unsigned int> *collision_count,
+                    const NearMissChecks *near_miss, std::vector<float> *min_distance,
+                    const FocusChecks *focus, std::vector<ClosestState> *closest,
+                    const std::vector<std::size_t> *check_pairs, LinkPairChecker *pair_checker,
+                    unsigned int batch_size, ThreadScratch *scratch, DefaultCollisionsProgress *progress,
+                    ThreadStats *stats)
     : scene_(scene),
       req_(req),
+      link_pairs_(link_pairs),
+      sampler_(sampler),
       thread_id_(thread_id),
-      num_trials_(num_trials),
+      trials_(trials),
       links_seen_colliding_(links_seen_colliding),
-      lock_(lock),
-      progress_(progress)
+      discoveries_(discoveries),
+      collision_count_(collision_count),
+      near_miss_(near_miss),
+      min_distance_(min_distance),
+      focus_(focus),
+      closest_(closest),
+      check_pairs_(check_pairs),
+      pair_checker_(pair_checker),
+      batch_size_(batch_size),
+      scratch_(scratch),
+      progress_(progress),
+      stats_(stats)
   {
   }
-  planning_scene::PlanningScene &scene_;
+  const planning_scene::PlanningScene &scene_;
   const collision_detection::CollisionRequest &req_;
+  const LinkPairMatrix &link_pairs_;
+  const JointSpaceSampler &sampler_;
   int thread_id_;
-  unsigned int   num_trials_;
-  StringPairSet *links_seen_colliding_;
-  boost::mutex  *lock_;
-  unsigned int  *progress_; // only to be updated by thread 0
+  TrialQueue *trials_; // trials of the round, shared by all threads
+  const PairBitset *links_seen_colliding_; // read-only while the threads are running
+  PairDiscoveries *discoveries_; // owned by this thread, merged after all threads joined
+  std::vector<unsigned int> *collision_count_; // owned by this thread, NULL if collisions are not counted
+  const NearMissChecks *near_miss_; // NULL if no distances are measured
+  std::vector<float> *min_distance_; // owned by this thread, reduced after all threads joined
+  const FocusChecks *focus_; // NULL if trials are not focused
+  std::vector<ClosestState> *closest_; // owned by this thread, indexed like focus_->pairs
+  const std::vector<std::size_t> *check_pairs_; // pairs to check one by one, NULL for full self collision checks
+  LinkPairChecker *pair_checker_; // owned by this thread, NULL if neither pairs are checked one by one nor distances
+                                  // measured
+  unsigned int batch_size_; // trials checked together by the pair checker
+  ThreadScratch *scratch_; // owned by this thread, kept between rounds
+  DefaultCollisionsProgress *progress_;
+  ThreadStats *stats_; // owned by this thread, reduced after all threads joined
+};
+
+// Struct for passing parameters to the threads of the always in collision check
+struct AlwaysThreadComputation
+{
+  AlwaysThreadComputation(const planning_scene::PlanningScene &scene, const collision_detection::CollisionRequest &req,
+                          const LinkPairMatrix &link_pairs, const JointSpaceSampler &sampler, TrialQueue *samples,
+                          std::vector<unsigned int> *collision_count, bool *max_contacts_reached,
+                          ThreadScratch *scratch, DefaultCollisionsProgress *progress, ThreadStats *stats)
+    : scene_(scene),
+      req_(req),
+      link_pairs_(link_pairs),
+      sampler_(sampler),
+      samples_(samples),
+      collision_count_(collision_count),
+      max_contacts_reached_(max_contacts_reached),
+      scratch_(scratch),
+      progress_(progress),
+      stats_(stats)
+  {
+  }
+  const planning_scene::PlanningScene &scene_;
+  const collision_detection::CollisionRequest &req_;
+  const LinkPairMatrix &link_pairs_;
+  const JointSpaceSampler &sampler_;
+  TrialQueue *samples_; // samples of the round, shared by all threads
+  std::vector<unsigned int> *collision_count_; // owned by this thread, summed up after all threads joined
+  bool *max_contacts_reached_; // set if any sample had at least max_contacts contacts
+  ThreadScratch *scratch_; // owned by this thread, kept between rounds
+  DefaultCollisionsProgress *progress_;
+  ThreadStats *stats_; // owned by this thread, reduced after all threads joined
 };
 
 // LinkGraph defines a Link's model and a set of unique links it connects
 typedef std::map<const robot_model::LinkModel*,
                  std::set<const robot_model::LinkModel*> > LinkGraph;
 
+// Depth of every link in the kinematic tree, the root link has depth 0
+typedef std::map<const robot_model::LinkModel*, unsigned int> LinkDepthMap;
+
+// Pair index and verdict of the pairs that keep the result of a previous run
+typedef std::vector<std::pair<std::size_t, LinkPairData> > KeptPairs;
+
 // ******************************************************************************************
 // Static Prototypes
 // ******************************************************************************************
@@ -112,7 +308,7 @@ typedef std::map<const robot_model::LinkModel*,
  * \return bool Was link pair already disabled from C.C.
  */
 static bool setLinkPair(const std::string &linkA, const std::string &linkB,
-                        const DisabledReason reason, LinkPairMap &link_pairs);
+                        const DisabledReason reason, LinkPairMatrix &link_pairs);
 
 /**
  * \brief Build the robot links connection graph and then check for links with no geomotry
@@ -128,6 +324,75 @@ static void computeConnectionGraph(const robot_model::LinkModel *link, LinkGraph
  */
 static void computeConnectionGraphRec(const robot_model::LinkModel *link, LinkGraph &link_graph);
 
+/**
+ * \brief Find the pairs whose verdict of a previous run is still valid, because their keys computed from the previous
+ * and the current link hashes match, and the settings of both runs are the same. Their collisions are not checked again
+ * \param scene A reference to the robot in the planning scene
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param request Previous verdicts, link hashes and settings hash
+ * \param links_seen_colliding Kept pairs are marked, so that they are not disabled as never colliding
+ * \param kept_pairs Filled with the kept pairs and their previous verdicts
+ */
+static void keepPreviousVerdicts(planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                                 const DefaultCollisionsRequest &request, PairBitset &links_seen_colliding,
+                                 KeptPairs &kept_pairs);
+
+/**
+ * \brief Add the settings of a request that change verdicts to a hash
+ */
+static void hashRequestSettings(const DefaultCollisionsRequest &request, ContentHash &hash);
+
+/**
+ * \brief Compute the cache key of every pair: a hash of the settings of the request, the geometry of both links and
+ * the joints and geometry of the links on the kinematic chain between them, up to their common parent
+ * \param scene A reference to the robot in the planning scene
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param request Settings that change verdicts
+ * \param keys Filled with the key of every pair index
+ */
+static void computeCacheKeys(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                             const DefaultCollisionsRequest &request, std::vector<boost::uint64_t> &keys);
+
+/**
+ * \brief Compute the key of every pair from given link hashes, see computeCacheKeys(). The chains follow the current
+ * robot model, links missing in the hashes count as changed
+ * \param model The current robot model
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param settings Hash of the settings of the request
+ * \param link_hashes Hashes of the links, of the current or of a previous version of the robot
+ * \param depth Depth of every link of the model
+ * \param keys Filled with the key of every pair index
+ */
+static void computePairKeys(const robot_model::RobotModel &model, const LinkPairMatrix &link_pairs,
+                            boost::uint64_t settings, const LinkHashMap &link_hashes, const LinkDepthMap &depth,
+                            std::vector<boost::uint64_t> &keys);
+
+/**
+ * \brief Keep the verdicts of the pairs that are in the cache. Their collisions are not checked again
+ * \param scene A reference to the robot in the planning scene
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param keys Cache key of every pair index
+ * \param cache Verdicts of earlier runs
+ * \param links_seen_colliding Kept pairs are marked, pairs already marked are not looked up
+ * \param kept_pairs Extended by the cached pairs and their verdicts
+ * \return number of pairs found in the cache
+ */
+static unsigned int keepCachedVerdicts(planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                                       const std::vector<boost::uint64_t> &keys, CollisionCache &cache,
+                                       PairBitset &links_seen_colliding, KeptPairs &kept_pairs);
+
+/**
+ * \brief Compute the depth of every link in the kinematic tree
+ */
+static void computeLinkDepths(const robot_model::RobotModel &model, LinkDepthMap &depth);
+
+/**
+ * \brief Find the deepest link that is a parent of both links, or one of the links itself
+ */
+static const robot_model::LinkModel* findCommonParent(const robot_model::LinkModel *link_a,
+                                                      const robot_model::LinkModel *link_b,
+                                                      const LinkDepthMap &depth);
+
 /**
  * \brief Disable collision checking for adjacent links, or adjacent with no geometry links between them
  * \param link_graph A representation of all bi-direcitonal joint connections between links in robot_description
@@ -136,7 +401,7 @@ static void computeConnectionGraphRec(const robot_model::LinkModel *link, LinkGr
  * \return number of adjacent links found and disabled
  */
 static unsigned int disableAdjacentLinks(planning_scene::PlanningScene &scene, LinkGraph &link_graph,
-                                         LinkPairMap &link_pairs);
+                                         LinkPairMatrix &link_pairs);
 
 
 /**
@@ -144,10 +409,64 @@ static unsigned int disableAdjacentLinks(planning_scene::PlanningScene &scene, L
  * \param scene A reference to the robot in the planning scene
  * \param link_pairs List of all unique link pairs and each pair's properties
  * \param req A reference to a collision request that is already initialized
+ * \param stats Counts the collision check
  * \return number of default collision links found and disabled
  */
-static unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scene, LinkPairMap &link_pairs,
-                                             collision_detection::CollisionRequest &req);
+static unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs,
+                                             collision_detection::CollisionRequest &req,
+                                             DefaultCollisionsPhaseStats &stats);
+
+/**
+ * \brief Disable link pairs that can never touch. For each link of a pair, a sphere is computed around the first joint
+ * below the common parent link of the pair that contains every position the link can reach, independent of the
+ * joint values. Pairs with disjoint spheres are disabled
+ * \param scene A reference to the robot in the planning scene
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \return number of unreachable link pairs found and disabled
+ */
+static unsigned int disableUnreachableLinks(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs);
+
+/**
+ * \brief Find the links of a link pair matrix in the robot model and the radius of their geometry
+ * \param links Filled with the link model of every link id
+ * \param link_radius Filled with the radius of every link id, see computeLinkRadius()
+ */
+static void computeLinkRadii(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                             std::vector<const robot_model::LinkModel*> &links, std::vector<double> &link_radius);
+
+/**
+ * \brief Lower bound on the distance of two links over all joint values, from the reach spheres around the first
+ * joints below their common parent link
+ * \param depth Depth of every link in the tree
+ * \return distance that may be negative if the links can get close, -infinity if their reach is unbounded
+ */
+static double computeReachGap(const robot_model::LinkModel *link_a, const robot_model::LinkModel *link_b,
+                              double radius_a, double radius_b, const LinkDepthMap &depth);
+
+/**
+ * \brief Compute a sphere that contains every position a link can reach relative to one of its parent links
+ * \param link The link whose motion is bounded
+ * \param parent A parent link of link, or link itself
+ * \param link_radius Radius of the geometry of link around its origin
+ * \param center Center of the sphere in the frame of parent
+ * \param radius Radius of the sphere
+ * \return false if the motion is unbounded, e.g. because of a planar or floating joint
+ */
+static bool computeReachSphere(const robot_model::LinkModel *link, const robot_model::LinkModel *parent,
+                               double link_radius, Eigen::Vector3d &center, double &radius);
+
+/**
+ * \brief Radius of a sphere around the origin of a link that contains all of its collision geometry
+ * \return negative if the geometry is unbounded
+ */
+static double computeLinkRadius(const robot_model::LinkModel *link, double padding, double scale);
+
+/**
+ * \brief Radius of a sphere around the origin of a shape that contains the shape, scaled and padded the way the
+ * collision robot does it
+ * \return negative if the shape is unbounded
+ */
+static double computeShapeRadius(const shapes::Shape *shape, double padding, double scale);
 
 /**
  * \brief Compute the links that are always in collision
@@ -155,25 +474,180 @@ static unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scen
  * \param link_pairs List of all unique link pairs and each pair's properties
  * \param req A reference to a collision request that is already initialized
  * \param links_seen_colliding Set of links that have at some point been seen in collision
+ * \param sampler Sequence of joint space samples
+ * \param progress Counts the samples and is checked for cancellation
+ * \param stats Filled with the counters of the phase and its threads
  * \param min_collision_fraction If collisions are found between a pair of links >= this fraction, the are assumed "always" in collision
  * \return number of always in collision links found and disabled
  */
-static unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, LinkPairMap &link_pairs,
+static unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs,
                                              collision_detection::CollisionRequest &req,
-                                             StringPairSet &links_seen_colliding,
+                                             PairBitset &links_seen_colliding, const JointSpaceSampler &sampler,
+                                             DefaultCollisionsProgress &progress, DefaultCollisionsStats &stats,
                                              double min_collision_faction = 0.95);
 
+/**
+ * \brief Thread for counting the collisions of each link pair in the samples it takes from a round of the always in
+ * collision check
+ * \param tc Struct that encapsulates all the data each thread needs
+ */
+static void disableAlwaysInCollisionThread(AlwaysThreadComputation tc);
+
+/**
+ * \brief Add states to the buffers of a thread until there are enough
+ * \param scratch Buffers of the thread, kept between the rounds of a phase
+ * \param model Robot of the states
+ * \param state_count Minimum number of states
+ */
+static void reserveThreadScratch(ThreadScratch &scratch, const robot_model::RobotModelConstPtr &model,
+                                 std::size_t state_count);
+
 /**
  * \brief Get the pairs of links that are never in collision
+ * \param request Number of trials and early termination settings
  * \param scene A reference to the robot in the planning scene
  * \param link_pairs List of all unique link pairs and each pair's properties
  * \param req A reference to a collision request that is already initialized
  * \param links_seen_colliding Set of links that have at some point been seen in collision
+ * \param sampler Sequence of joint space samples, each trial uses the sample with its own number
+ * \param progress Counts the samples and is checked for cancellation
+ * \param report Filled with the number of trials done and the discovery rate bound reached
  * \return number of never in collision links found and disabled
  */
-static unsigned int disableNeverInCollision(const unsigned int num_trials, planning_scene::PlanningScene &scene,
-                                            LinkPairMap &link_pairs, const collision_detection::CollisionRequest &req,
-                                            StringPairSet &links_seen_colliding, unsigned int *progress);
+static unsigned int disableNeverInCollision(const DefaultCollisionsRequest &request, planning_scene::PlanningScene &scene,
+                                            LinkPairMatrix &link_pairs, const collision_detection::CollisionRequest &req,
+                                            PairBitset &links_seen_colliding, const JointSpaceSampler &sampler,
+                                            DefaultCollisionsProgress &progress, DefaultCollisionsReport &report);
+
+/**
+ * \brief Select the pairs that get distance queries in the never in collision check: all pairs that are neither
+ * disabled nor known to collide, except the ones whose reach proves them farther apart than the margin
+ * \param scene A reference to the robot in the planning scene
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param links_seen_colliding Set of links that have at some point been seen in collision
+ * \param margin Distance below which a pair is a near miss
+ * \param checks Filled with the candidates and the data the threads need to query them
+ * \param min_distance Set to the lower bound of the reach for the pairs that are proven far apart, infinity otherwise
+ */
+static void prepareNearMissChecks(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                                  const PairBitset &links_seen_colliding, double margin, NearMissChecks &checks,
+                                  std::vector<float> &min_distance);
+
+/**
+ * \brief Update the smallest distances of the near miss candidates in one sample. The exact distance is only
+ * queried if the bounding spheres of the links are closer than the margin
+ * \param tc Data of the calling thread
+ * \param kstate Sampled state, with collision body transforms already updated
+ * \param thread_touched Pairs this thread saw colliding, their distance is 0 and not queried again
+ * \return number of distance queries done
+ */
+static unsigned int checkNearMisses(const ThreadComputation &tc, const robot_state::RobotState &kstate,
+                                    const PairBitset &thread_touched);
+
+/**
+ * \brief Count a colliding pair of a never in collision trial and remember when the thread saw it first
+ * \param tc Data of the calling thread
+ * \param index Pair index
+ * \param trial Number of the trial
+ * \param focused Whether the trial was focused, those are not counted
+ * \param thread_seen_colliding Pairs the thread saw colliding, only used when collisions are counted
+ * \param thread_touched Pairs the thread saw colliding, only used when near misses are checked
+ * \return true if the thread does not need to check the pair anymore
+ */
+static bool recordCollision(const ThreadComputation &tc, std::size_t index, unsigned int trial, bool focused,
+                            PairBitset &thread_seen_colliding, PairBitset &thread_touched);
+
+/**
+ * \brief Whether a trial of the never in collision check focuses on undecided pairs. Focused trials are spread
+ * evenly over the sequence
+ * \param trial Number of the trial
+ * \param fraction Fraction of the trials that are focused
+ */
+static bool isFocusedTrial(unsigned int trial, double fraction);
+
+/**
+ * \brief Collect the joints that move two links relative to each other, i.e. the joints on the path from both links
+ * up to their common parent. Mimic joints are replaced by the joints they follow
+ * \param depth Depth of every link in the tree
+ * \param joints Filled with the joints, without duplicates
+ */
+static void computePairJoints(const robot_model::LinkModel *link_a, const robot_model::LinkModel *link_b,
+                              const LinkDepthMap &depth, std::vector<const robot_model::JointModel*> &joints);
+
+/**
+ * \brief Remember the sample in which the links of each undecided pair came closest so far
+ * \param tc Data of the calling thread
+ * \param kstate Sampled state, with link transforms already updated
+ * \param trial Number of the trial of the sample
+ */
+static void trackClosestStates(const ThreadComputation &tc, const robot_state::RobotState &kstate,
+                               unsigned int trial);
+
+/**
+ * \brief Let the focused sampler perturb the joints between the links of every undecided pair, starting from the
+ * state in which the links came closest
+ * \param link_pairs List of all unique link pairs and each pair's properties
+ * \param decided Pairs that collided or came closer than the near-miss margin
+ * \param focus Links and undecided pairs of the last round
+ * \param closest Closest state of every pair index
+ * \param depth Depth of every link in the tree
+ * \param sampler Sampler to update
+ */
+static void updateFocusTargets(const LinkPairMatrix &link_pairs, const PairBitset &decided, const FocusChecks &focus,
+                               const std::vector<ClosestState> &closest, const LinkDepthMap &depth,
+                               FocusedSampler &sampler);
+
+/**
+ * \brief Count the pairs that are disabled or have been seen colliding, whose verdict is therefore known
+ */
+static std::size_t countResolvedPairs(const LinkPairMatrix &link_pairs, const PairBitset &links_seen_colliding);
+
+/**
+ * \brief Hash of the robot and all settings the never in collision trials depend on, checkpoints are only resumed
+ * with the same key
+ */
+static boost::uint64_t computeCheckpointKey(const planning_scene::PlanningScene &scene,
+                                            const DefaultCollisionsRequest &request);
+
+/**
+ * \brief Copy the state of the never in collision trials after a complete round into a checkpoint
+ * \param trials_done Number of trials of all complete rounds
+ * \param report Counters of the trials
+ * \param collision_count Collisions per pair index in the uniform trials, empty if collisions are not counted
+ * \param min_distance Smallest distance per pair index, empty if no distances are measured
+ * \param closest Closest state per pair index, empty if trials are not focused
+ */
+static void fillCheckpoint(unsigned int trials_done, const DefaultCollisionsReport &report,
+                           const PairBitset &links_seen_colliding, const PairBitset &near_pairs,
+                           const std::vector<unsigned int> &collision_count, const std::vector<float> &min_distance,
+                           const std::vector<ClosestState> &closest, CollisionCheckpoint &checkpoint);
+
+/**
+ * \brief Add the counters of the threads of a round to the statistics of a phase
+ * \param thread_stats Counters of every thread in the round
+ * \param phase_stats Statistics of the phase the round belongs to
+ * \param stats Statistics of the whole run, for the per thread counters and the barrier wait time
+ */
+static void reduceThreadStats(const std::vector<ThreadStats> &thread_stats, DefaultCollisionsPhaseStats &phase_stats,
+                              DefaultCollisionsStats &stats);
+
+/**
+ * \brief CPU time of the process in seconds, summed over all threads
+ */
+static double processCpuTime();
+
+/**
+ * \brief Write the progress in percent to the legacy progress variable
+ */
+static void copyProgressPercent(const DefaultCollisionsProgress &progress, unsigned int *percent);
+
+/**
+ * \brief Derive the seed of the sampler of one phase from the seed of the computation
+ * \param seed Seed of the computation, negative if unseeded
+ * \param phase Reason assigned by the phase
+ * \return Seed of the phase, negative if unseeded
+ */
+static int phaseSeed(int seed, DisabledReason phase);
 
 /**
  * \brief Thread for getting the pairs of links that are never in collision
@@ -189,14 +663,45 @@ computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_sce
                          const bool include_never_colliding, const unsigned int num_trials, const double min_collision_fraction,
                          const bool verbose)
 {
+  DefaultCollisionsRequest request;
+  request.include_never_colliding = include_never_colliding;
+  request.trials = num_trials;
+  request.min_collision_fraction = min_collision_fraction;
+  request.verbose = verbose;
+
+  DefaultCollisionsProgress collision_progress;
+  collision_progress.setCallback(boost::bind(&copyProgressPercent, _1, progress));
+  return computeDefaultCollisions(parent_scene, request, &collision_progress);
+}
+
+LinkPairMap
+computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_scene,
+                         const DefaultCollisionsRequest &request, DefaultCollisionsProgress *progress,
+                         DefaultCollisionsReport *report)
+{
+  DefaultCollisionsReport local_report;
+  if (!report)
+    report = &local_report;
+  *report = DefaultCollisionsReport();
+
+  DefaultCollisionsProgress local_progress;
+  if (!progress)
+    progress = &local_progress;
+
   // Create new instance of planning scene using pointer
   planning_scene::PlanningScenePtr scene = parent_scene->diff();
 
-  // Map of disabled collisions that contains a link as a key and an ordered list of links that are connected.
-  LinkPairMap link_pairs;
+  // Dense matrix of all link pairs, only converted to the string-based LinkPairMap when returning
+  LinkPairMatrix link_pairs(scene->getRobotModel()->getLinkModelNamesWithCollisionGeometry());
+  progress->start(link_pairs.pairCount());
+
+  DefaultCollisionsStats &stats = report->stats;
+  // hardware_concurrency() is 0 if the number of cores is unknown. The threads of the pool stay for later runs
+  stats.threads = request.threads > 0 ? request.threads : std::max(1u, boost::thread::hardware_concurrency());
+  WorkerPool::getInstance().reserve(stats.threads);
 
   // Track unique edges that have been found to be in collision in some state
-  StringPairSet links_seen_colliding;
+  PairBitset links_seen_colliding(link_pairs.pairCount());
 
   // LinkGraph is a custom type of a map with a LinkModel as key and a set of LinkModels as second
   LinkGraph link_graph;
@@ -204,23 +709,45 @@ computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_sce
   //ROS_INFO_STREAM("Initial allowed Collision Matrix Size = " << scene.getAllowedCollisions().getSize() );
 
   // 0. GENERATE ALL POSSIBLE LINK PAIRS -------------------------------------------------------------
-  // Generate a list of unique link pairs for all links with geometry. Order pairs alphabetically.
-  // There should be n choose 2 pairs
-  computeLinkPairs( *scene, link_pairs );
-  *progress = 1;
+  // The link pair matrix already holds the n choose 2 unique pairs of all links with geometry.
+  // Pairs that are not affected by changes since a previous run keep its verdict and are not checked again
+  KeptPairs kept_pairs;
+  if (request.previous_link_pairs && request.previous_link_hashes)
+    keepPreviousVerdicts(*scene, link_pairs, request, links_seen_colliding, kept_pairs);
+  report->kept_pairs = kept_pairs.size();
+
+  // Pairs whose links and chain are known from earlier runs take the cached verdict
+  std::vector<boost::uint64_t> cache_keys;
+  if (request.cache)
+  {
+    computeCacheKeys(*scene, link_pairs, request, cache_keys);
+    report->cached_pairs = keepCachedVerdicts(*scene, link_pairs, cache_keys, *request.cache, links_seen_colliding,
+                                              kept_pairs);
+  }
+  progress->setPairsResolved(kept_pairs.size());
+
+  // If every pair keeps its verdict, nothing changed that sampling could find. Otherwise the samples only need to be
+  // checked for the remaining pairs, one by one, instead of a full self collision check
+  const bool all_kept = kept_pairs.size() == link_pairs.pairCount();
+  DefaultCollisionsRequest sampling_request = request;
+  if (!kept_pairs.empty())
+    sampling_request.pairwise_checks = true;
 
   // 1. FIND CONNECTING LINKS ------------------------------------------------------------------------
   // For each link, compute the set of other links it connects to via a single joint (adjacent links)
   // or via a chain of joints with intermediate links with no geometry (like a socket joint)
+  progress->setPhase(PHASE_ADJACENT, 1, 4); // Progress bar feedback
+  PhaseTimer adjacent_timer(stats.phases[PHASE_ADJACENT]);
 
   // Create Connection Graph
   computeConnectionGraph(scene->getRobotModel()->getRootLink(), link_graph);
-  *progress = 2; // Progress bar feedback
 
   // 2. DISABLE ALL ADJACENT LINK COLLISIONS ---------------------------------------------------------
   // if 2 links are adjacent, or adjacent with a zero-shape between them, disable collision checking for them
   unsigned int num_adjacent = disableAdjacentLinks( *scene, link_graph, link_pairs);
-  *progress = 4; // Progress bar feedback
+  stats.phases[PHASE_ADJACENT].pairs_disabled = num_adjacent;
+  adjacent_timer.stop();
+  progress->setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding));
 
   // 3. INITIAL CONTACTS TO CONSIDER GUESS -----------------------------------------------------------
   // Create collision detection request object
@@ -233,32 +760,94 @@ computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_sce
 
   // 4. DISABLE "DEFAULT" COLLISIONS --------------------------------------------------------
   // Disable all collision checks that occur when the robot is started in its default state
-  unsigned int num_default = disableDefaultCollisions(*scene, link_pairs, req);
-  *progress = 6; // Progress bar feedback
+  progress->setPhase(PHASE_DEFAULT, 4, 6); // Progress bar feedback
+  PhaseTimer default_timer(stats.phases[PHASE_DEFAULT]);
+  unsigned int num_default = disableDefaultCollisions(*scene, link_pairs, req, stats.phases[PHASE_DEFAULT]);
+  stats.phases[PHASE_DEFAULT].pairs_disabled = num_default;
+  default_timer.stop();
+  progress->setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding));
+
+  // 5. OUT OF REACH ----------------------------------------------------------------------------
+  // Disable pairs whose reachable volumes never intersect, before any random sampling is done
+  unsigned int num_unreachable = 0;
+  if (request.include_never_colliding && !all_kept && !progress->isCancelled())
+  {
+    progress->setPhase(PHASE_UNREACHABLE, 6, 7); // Progress bar feedback
+    PhaseTimer unreachable_timer(stats.phases[PHASE_UNREACHABLE]);
+    num_unreachable = disableUnreachableLinks(*scene, link_pairs);
+    stats.phases[PHASE_UNREACHABLE].pairs_disabled = num_unreachable;
+    unreachable_timer.stop();
+    progress->setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding));
+  }
 
-  // 5. ALWAYS IN COLLISION --------------------------------------------------------------------
+  // 6. ALWAYS IN COLLISION --------------------------------------------------------------------
   // Compute the links that are always in collision
-  unsigned int num_always = disableAlwaysInCollision(*scene, link_pairs, req, links_seen_colliding, min_collision_fraction);
+  unsigned int num_always = 0;
+  if (!all_kept && !progress->isCancelled())
+  {
+    progress->setPhase(PHASE_ALWAYS, 7, 8); // Progress bar feedback
+    PhaseTimer always_timer(stats.phases[PHASE_ALWAYS]);
+    JointSpaceSamplerPtr always_sampler = createJointSpaceSampler(request.sampler, scene->getRobotModel(),
+                                                                  phaseSeed(request.seed, ALWAYS));
+    num_always = disableAlwaysInCollision(*scene, link_pairs, req, links_seen_colliding, *always_sampler, *progress,
+                                          stats, request.min_collision_fraction);
+    stats.phases[PHASE_ALWAYS].pairs_disabled = num_always;
+    always_timer.stop();
+    progress->setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding));
+  }
   //ROS_INFO("Links seen colliding total = %d", int(links_seen_colliding.size()));
-  *progress = 8; // Progress bar feedback
 
-  // 6. NEVER IN COLLISION -------------------------------------------------------------------
+  // 7. NEVER IN COLLISION -------------------------------------------------------------------
   // Get the pairs of links that are never in collision
   unsigned int num_never = 0;
-  if (include_never_colliding) // option of function
+  if (request.include_never_colliding && !all_kept && !progress->isCancelled()) // option of function
   {
-    num_never = disableNeverInCollision(num_trials, *scene, link_pairs, req, links_seen_colliding, progress);
+    progress->setPhase(PHASE_NEVER, 8, 100, request.trials); // Progress bar feedback
+    PhaseTimer never_timer(stats.phases[PHASE_NEVER]);
+    JointSpaceSamplerPtr never_sampler = createJointSpaceSampler(request.sampler, scene->getRobotModel(),
+                                                                 phaseSeed(request.seed, NEVER));
+    num_never = disableNeverInCollision(sampling_request, *scene, link_pairs, req, links_seen_colliding,
+                                        *never_sampler, *progress, *report);
+    stats.phases[PHASE_NEVER].pairs_disabled = num_never;
+    never_timer.stop();
   }
+  report->cancelled = progress->isCancelled();
 
   //ROS_INFO("Link pairs seen colliding ever: %d", int(links_seen_colliding.size()));
 
-  if(verbose)
+  // Restore the previous verdicts, the phases above may have assigned another reason to kept pairs
+  for (KeptPairs::const_iterator it = kept_pairs.begin() ; it != kept_pairs.end() ; ++it)
+    link_pairs.setLinkPairData(it->first, it->second);
+
+  // Only a complete run has a verdict for every pair. A run stopped by the time budget did fewer trials than the
+  // settings in the cache key ask for, its never in collision verdicts must not be taken by later runs
+  if (request.cache && !report->cancelled && !report->budget_exhausted)
+  {
+    // Kept and cached pairs were not computed in this run
+    PairBitset kept(link_pairs.pairCount());
+    for (KeptPairs::const_iterator it = kept_pairs.begin() ; it != kept_pairs.end() ; ++it)
+      kept.set(it->first);
+
+    LinkPairMap::value_type::second_type data;
+    for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+    {
+      if (kept.test(index))
+        continue;
+      data.reason = link_pairs.reason(index);
+      data.disable_check = link_pairs.disabled(index);
+      data.collision_frequency = link_pairs.collisionFrequency(index);
+      data.min_distance = link_pairs.minDistance(index);
+      request.cache->store(cache_keys[index], data);
+    }
+  }
+
+  if(request.verbose)
   {
     // Calculate number of disabled links:
     unsigned int num_disabled = 0;
-    for ( LinkPairMap::const_iterator pair_it = link_pairs.begin() ; pair_it != link_pairs.end() ; ++pair_it)
+    for (std::size_t i = 0 ; i < link_pairs.pairCount() ; ++i)
     {
-      if( pair_it->second.disable_check ) // has a reason to be disabled
+      if( link_pairs.disabled(i) ) // has a reason to be disabled
         ++num_disabled;
     }
 
@@ -272,10 +861,37 @@ computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_sce
     ROS_INFO("%6.0f : %s", num_possible, "Total possible collisions");
     ROS_INFO("%6d : %s",   num_always, "Always in collision");
     ROS_INFO("%6d : %s",   num_never, "Never in collision");
+    ROS_INFO("%6d : %s",   num_unreachable, "Out of reach");
     ROS_INFO("%6d : %s",   num_default, "Default in collision");
     ROS_INFO("%6d : %s",   num_adjacent, "Adjacent links disabled");
     ROS_INFO("%6d : %s",   num_sometimes, "Sometimes in collision");
     ROS_INFO("%6d : %s",   num_disabled, "TOTAL DISABLED");
+    if (request.previous_link_pairs && request.previous_link_hashes)
+      ROS_INFO("%6d : %s",   report->kept_pairs, "Kept from previous run");
+    if (request.cache)
+      ROS_INFO("%6d : %s",   report->cached_pairs, "Taken from the cache");
+    if (request.max_collision_frequency > 0.0)
+      ROS_INFO("%6d : %s",   report->rarely_colliding, "Rarely in collision");
+    if (request.near_miss_margin > 0.0)
+      ROS_INFO("%6d : %s",   report->near_misses, "Near misses, kept enabled");
+    if (request.focus_fraction > 0.0)
+      ROS_INFO("%6d : %s",   report->focused_trials, "Trials focused on undecided pairs");
+    if (report->resumed_trials > 0)
+      ROS_INFO("%6d : %s",   report->resumed_trials, "Trials taken from the checkpoint");
+    if (request.include_never_colliding)
+    {
+      ROS_INFO("%6d : %s",   report->trials, report->stopped_early ? "Trials (stopped early)" : "Trials");
+      ROS_INFO("%6d : %s",   report->last_discovery, "Trials until last new colliding pair");
+      ROS_INFO("%6.4f : %s", report->discovery_rate_bound, "Bound on rate of new colliding pairs");
+      if (request.max_discovery_rate > 0.0)
+        ROS_INFO("%6.4f : %s", report->confidence_reached, "Confidence reached for the requested rate");
+      if (report->budget_exhausted)
+        ROS_INFO("%6.1f : %s", request.time_budget, "Time budget used up (s)");
+    }
+    for (int phase = PHASE_ADJACENT ; phase < PHASE_DONE ; ++phase)
+      ROS_INFO("%6.2f : %s (s), %lu collision checks", stats.phases[phase].wall_time,
+               defaultCollisionsPhaseToString((DefaultCollisionsPhase)phase).c_str(),
+               stats.phases[phase].collision_checks);
 
     /*ROS_INFO("Copy to Spreadsheet:");
     ROS_INFO_STREAM(num_links << "\t" << num_possible << "\t" << num_always << "\t" << num_never
@@ -284,101 +900,361 @@ computeDefaultCollisions(const planning_scene::PlanningSceneConstPtr &parent_sce
     */
   }
 
-  *progress = 100; // end the status bar
+  LinkPairMap link_pair_map;
+  link_pairs.toLinkPairMap(link_pair_map);
 
-  return link_pairs;
+  progress->setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding));
+  progress->setPhase(PHASE_DONE, 100, 100); // end the status bar
+  return link_pair_map;
 }
 
 // ******************************************************************************************
 // Helper function for adding two links to the disabled links data structure
 // ******************************************************************************************
 bool setLinkPair(const std::string &linkA, const std::string &linkB,
-                 const DisabledReason reason, LinkPairMap &link_pairs)
+                 const DisabledReason reason, LinkPairMatrix &link_pairs)
 {
-  bool isUnique = false; // determine if this link pair had already existsed in the link_pairs datastructure
-
-  // Determine order of the 2 links in the pair
-  std::pair<std::string, std::string> link_pair;
-
-  // compare the string names of the two links and add the lesser alphabetically, s.t. the pair is only added once
-  if ( linkA < linkB )
-  {
-    link_pair = std::pair<std::string, std::string>( linkA, linkB );
-  }
-  else
+  std::size_t index;
+  if (!link_pairs.pairIndex(linkA, linkB, index))
   {
-    link_pair = std::pair<std::string, std::string>( linkB, linkA );
+    ROS_DEBUG("Ignoring link pair %s and %s without collision geometry", linkA.c_str(), linkB.c_str());
+    return false;
   }
 
-  // Update properties of this link pair using only 1 search
-  LinkPairData *link_pair_ptr = &link_pairs[ link_pair ];
+  return link_pairs.setLinkPair(index, reason);
+}
+
+// ******************************************************************************************
+// Generate a list of unique link pairs for all links with geometry. Order pairs alphabetically. n choose 2 pairs
+// ******************************************************************************************
+void computeLinkPairs( const planning_scene::PlanningScene &scene, LinkPairMap &link_pairs )
+{
+  // Get the names of the link models that have some collision geometry associated to themselves
+  LinkPairMatrix matrix(scene.getRobotModel()->getLinkModelNamesWithCollisionGeometry());
+
+  // Every combination of name pairs, not disabled
+  matrix.toLinkPairMap(link_pairs);
+}
+
+// ******************************************************************************************
+// Intern link names and create all n choose 2 pairs
+// ******************************************************************************************
+const unsigned char LinkPairMatrix::REASON_MASK;
+const unsigned char LinkPairMatrix::DISABLED_BIT;
+
+LinkPairMatrix::LinkPairMatrix()
+{
+}
+
+LinkPairMatrix::LinkPairMatrix(const std::vector<std::string> &link_names)
+  : names_(link_names)
+{
+  // Sort the names so that the ids follow the alphabetical pair ordering of LinkPairMap
+  std::sort(names_.begin(), names_.end());
+  names_.erase(std::unique(names_.begin(), names_.end()), names_.end());
+
+  for (std::size_t i = 0 ; i < names_.size() ; ++i)
+    ids_[names_[i]] = i;
+
+  // Packed upper triangle, row by row
+  for (std::size_t i = 0 ; i < names_.size() ; ++i)
+    for (std::size_t j = i + 1 ; j < names_.size() ; ++j)
+      pair_links_.push_back(std::make_pair(int(i), int(j)));
+
+  data_.resize(pair_links_.size(), NOT_DISABLED);
+  frequency_.resize(pair_links_.size(), -1.0f);
+  distance_.resize(pair_links_.size(), -1.0f);
+}
+
+// ******************************************************************************************
+// Id of a link name
+// ******************************************************************************************
+int LinkPairMatrix::linkId(const std::string &name) const
+{
+  boost::unordered_map<std::string, int>::const_iterator it = ids_.find(name);
+  return it == ids_.end() ? -1 : it->second;
+}
+
+// ******************************************************************************************
+// Index of a pair of link names
+// ******************************************************************************************
+bool LinkPairMatrix::pairIndex(const std::string &linkA, const std::string &linkB, std::size_t &index) const
+{
+  int a = linkId(linkA);
+  int b = linkId(linkB);
+  if (a < 0 || b < 0 || a == b)
+    return false;
+
+  index = pairIndex(a, b);
+  return true;
+}
+
+// ******************************************************************************************
+// Update the reason/disable bits of a pair
+// ******************************************************************************************
+bool LinkPairMatrix::setLinkPair(std::size_t index, DisabledReason reason)
+{
+  bool isUnique = false; // determine if this link pair had already been disabled
 
-  // Check if link pair was already disabled. It also creates the entry if none existed
-  if( link_pairs[ link_pair ].disable_check == false ) // it was not previously disabled
+  unsigned char &data = data_[index];
+  if (!(data & DISABLED_BIT)) // it was not previously disabled
   {
     isUnique = true;
-    link_pair_ptr->reason = reason; // only change the reason if the pair was previously enabled
+    data = reason; // only change the reason if the pair was previously enabled
   }
 
   // Only disable collision checking if there is a reason to disable it. This func is also used for initializing pairs
-  link_pair_ptr->disable_check = (reason != NOT_DISABLED);
+  if (reason != NOT_DISABLED)
+    data |= DISABLED_BIT;
+  else
+    data &= ~DISABLED_BIT;
 
   return isUnique;
 }
 
 // ******************************************************************************************
-// Generate a list of unique link pairs for all links with geometry. Order pairs alphabetically. n choose 2 pairs
+// Overwrite the reason/disable bits of a pair
 // ******************************************************************************************
-void computeLinkPairs( const planning_scene::PlanningScene &scene, LinkPairMap &link_pairs )
+void LinkPairMatrix::setLinkPairData(std::size_t index, const LinkPairData &data)
 {
-  // Get the names of the link models that have some collision geometry associated to themselves
-  const std::vector<std::string> &names = scene.getRobotModel()->getLinkModelNamesWithCollisionGeometry();
+  data_[index] = data.reason;
+  if (data.disable_check)
+    data_[index] |= DISABLED_BIT;
+  frequency_[index] = data.collision_frequency;
+  distance_[index] = data.min_distance;
+}
 
-  std::pair<std::string,std::string> temp_pair;
+// ******************************************************************************************
+// Convert to the string-based representation
+// ******************************************************************************************
+void LinkPairMatrix::toLinkPairMap(LinkPairMap &link_pairs) const
+{
+  LinkPairData link_pair_data;
 
-  // Loop through every combination of name pairs, AB and BA, n^2
-  for (std::size_t i = 0 ; i < names.size() ; ++i)
+  // Pairs are generated in the map's ordering already, so every insert goes at the end
+  for (std::size_t i = 0 ; i < pair_links_.size() ; ++i)
   {
-    for (std::size_t j = i+1 ; j < names.size() ; ++j)
-    {
-      // Add to link pairs list
-      setLinkPair( names[i], names[j], NOT_DISABLED, link_pairs );
-    }
+    link_pair_data.reason = reason(i);
+    link_pair_data.disable_check = disabled(i);
+    link_pair_data.collision_frequency = frequency_[i];
+    link_pair_data.min_distance = distance_[i];
+    link_pairs.insert(link_pairs.end(),
+                      LinkPairMap::value_type(std::make_pair(names_[pair_links_[i].first],
+                                                             names_[pair_links_[i].second]), link_pair_data));
   }
 }
+
 // ******************************************************************************************
-// Build the robot links connection graph and then check for links with no geomotry
+// Find the pairs whose verdict of a previous run is still valid
 // ******************************************************************************************
-void computeConnectionGraph(const robot_model::LinkModel *start_link, LinkGraph &link_graph)
+void keepPreviousVerdicts(planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                          const DefaultCollisionsRequest &request, PairBitset &links_seen_colliding,
+                          KeptPairs &kept_pairs)
 {
-  link_graph.clear(); // make sure the edges structure is clear
+  // A verdict of a run with fewer trials, for example, is no verdict of this run
+  const boost::uint64_t settings = hashDefaultCollisionsSettings(request);
+  if (request.previous_settings_hash != settings)
+  {
+    ROS_INFO("The settings differ from the previous run, all link pairs are computed again");
+    return;
+  }
 
-  // Recurively build adj list of link connections
-  computeConnectionGraphRec(start_link, link_graph);
+  const robot_model::RobotModelConstPtr &model = scene.getRobotModel();
 
-  // Repeatidly check for links with no geometry and remove them, then re-check until no more removals are detected
-  bool update = true; // track if a no geometry link was found
-  while (update)
+  // The same keys as the cache, once from the previous and once from the current link hashes. They match if
+  // nothing changed that decides about the verdict, including links without geometry on the chain
+  LinkHashMap link_hashes;
+  computeLinkHashes(scene, link_hashes);
+  LinkDepthMap depth;
+  computeLinkDepths(*model, depth);
+  std::vector<boost::uint64_t> previous_keys, keys;
+  computePairKeys(*model, link_pairs, settings, *request.previous_link_hashes, depth, previous_keys);
+  computePairKeys(*model, link_pairs, settings, link_hashes, depth, keys);
+
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
   {
-    update = false; // default
+    if (previous_keys[index] != keys[index])
+      continue;
 
-    // Check if each edge has a shape
-    for (LinkGraph::const_iterator edge_it = link_graph.begin() ; edge_it != link_graph.end() ; ++edge_it)
-    {
-      if (edge_it->first->getShapes().empty()) // link in adjList "link_graph" does not have shape, remove!
-      {
-        // Temporary list for connected links
-        std::vector<const robot_model::LinkModel*> temp_list;
+    // Pairs missing in the previous result, like those of files written without verdicts, are computed again
+    const std::string &name_a = link_pairs.linkName(link_pairs.firstLink(index));
+    const std::string &name_b = link_pairs.linkName(link_pairs.secondLink(index));
+    LinkPairMap::const_iterator it = request.previous_link_pairs->find(std::make_pair(name_a, name_b));
+    if (it == request.previous_link_pairs->end())
+      continue;
+    kept_pairs.push_back(std::make_pair(index, it->second));
 
-        // Copy link's parent and child links to temp_list
-        for (std::set<const robot_model::LinkModel*>::const_iterator adj_it = edge_it->second.begin();
-             adj_it != edge_it->second.end();
-             ++adj_it)
-        {
-          temp_list.push_back(*adj_it);
-        }
+    // disable link checking in the collision matrix
+    scene.getAllowedCollisionMatrixNonConst().setEntry(name_a, name_b, true);
+    links_seen_colliding.set(index);
+  }
+  //ROS_INFO("Kept %d link pairs of the previous run", int(kept_pairs.size()));
+}
 
-        // Make all preceeding and succeeding links to the no-shape link fully connected
+// ******************************************************************************************
+// Hash of the settings of a request that change verdicts
+// ******************************************************************************************
+boost::uint64_t hashDefaultCollisionsSettings(const DefaultCollisionsRequest &request)
+{
+  ContentHash hash;
+  hashRequestSettings(request, hash);
+  return hash.value();
+}
+
+// ******************************************************************************************
+// Add the settings of a request that change verdicts to a hash
+// ******************************************************************************************
+void hashRequestSettings(const DefaultCollisionsRequest &request, ContentHash &hash)
+{
+  // The number of trials is part of it, since fewer trials may miss rare collisions
+  hash.add((boost::uint64_t)request.include_never_colliding).add((boost::uint64_t)request.trials);
+  hash.add(request.min_collision_fraction).add(request.max_discovery_rate).add(request.termination_confidence);
+  hash.add(request.max_collision_frequency).add(request.near_miss_margin);
+}
+
+// ******************************************************************************************
+// Compute the cache key of every pair
+// ******************************************************************************************
+void computeCacheKeys(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                      const DefaultCollisionsRequest &request, std::vector<boost::uint64_t> &keys)
+{
+  LinkHashMap link_hashes;
+  computeLinkHashes(scene, link_hashes);
+
+  LinkDepthMap depth;
+  computeLinkDepths(*scene.getRobotModel(), depth);
+
+  computePairKeys(*scene.getRobotModel(), link_pairs, hashDefaultCollisionsSettings(request), link_hashes, depth,
+                  keys);
+}
+
+// ******************************************************************************************
+// Compute the key of every pair from given link hashes
+// ******************************************************************************************
+void computePairKeys(const robot_model::RobotModel &model, const LinkPairMatrix &link_pairs,
+                     boost::uint64_t settings, const LinkHashMap &link_hashes, const LinkDepthMap &depth,
+                     std::vector<boost::uint64_t> &keys)
+{
+  keys.resize(link_pairs.pairCount());
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+  {
+    const robot_model::LinkModel *link_a = model.getLinkModel(link_pairs.linkName(link_pairs.firstLink(index)));
+    const robot_model::LinkModel *link_b = model.getLinkModel(link_pairs.linkName(link_pairs.secondLink(index)));
+    const robot_model::LinkModel *parent = findCommonParent(link_a, link_b, depth);
+
+    // Links without geometry on the chain decide about adjacency, so the geometry of every link on it counts.
+    // The chains of both links are separated by their length
+    ContentHash key;
+    key.add(settings).add(findLinkHash(link_hashes, parent->getName()).geometry);
+    const robot_model::LinkModel *pair_links[2] = { link_a, link_b };
+    for (int i = 0 ; i < 2 ; ++i)
+    {
+      boost::uint64_t length = 0;
+      for (const robot_model::LinkModel *l = pair_links[i] ; l != parent ; l = l->getParentLinkModel(), ++length)
+      {
+        const LinkHash &hash = findLinkHash(link_hashes, l->getName());
+        key.add(hash.geometry).add(hash.joint);
+      }
+      key.add(length);
+    }
+    keys[index] = key.value();
+  }
+}
+
+// ******************************************************************************************
+// Keep the verdicts of the pairs that are in the cache
+// ******************************************************************************************
+unsigned int keepCachedVerdicts(planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                                const std::vector<boost::uint64_t> &keys, CollisionCache &cache,
+                                PairBitset &links_seen_colliding, KeptPairs &kept_pairs)
+{
+  unsigned int num_cached = 0;
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+  {
+    LinkPairData data;
+    if (links_seen_colliding.test(index) || !cache.lookup(keys[index], data))
+      continue;
+
+    kept_pairs.push_back(std::make_pair(index, data));
+    ++num_cached;
+
+    // disable link checking in the collision matrix
+    scene.getAllowedCollisionMatrixNonConst().setEntry(link_pairs.linkName(link_pairs.firstLink(index)),
+                                                       link_pairs.linkName(link_pairs.secondLink(index)), true);
+    links_seen_colliding.set(index);
+  }
+  //ROS_INFO("Took %d link pairs from the cache", num_cached);
+
+  return num_cached;
+}
+
+// ******************************************************************************************
+// Compute the depth of every link in the kinematic tree
+// ******************************************************************************************
+void computeLinkDepths(const robot_model::RobotModel &model, LinkDepthMap &depth)
+{
+  depth.clear();
+  for (std::size_t i = 0 ; i < model.getLinkModels().size() ; ++i)
+  {
+    unsigned int d = 0;
+    for (const robot_model::LinkModel *l = model.getLinkModels()[i]->getParentLinkModel() ; l ; l = l->getParentLinkModel())
+      ++d;
+    depth[model.getLinkModels()[i]] = d;
+  }
+}
+
+// ******************************************************************************************
+// Find the deepest link that is a parent of both links
+// ******************************************************************************************
+const robot_model::LinkModel* findCommonParent(const robot_model::LinkModel *link_a,
+                                               const robot_model::LinkModel *link_b,
+                                               const LinkDepthMap &depth)
+{
+  while (depth.find(link_a)->second > depth.find(link_b)->second)
+    link_a = link_a->getParentLinkModel();
+  while (depth.find(link_b)->second > depth.find(link_a)->second)
+    link_b = link_b->getParentLinkModel();
+  while (link_a != link_b)
+  {
+    link_a = link_a->getParentLinkModel();
+    link_b = link_b->getParentLinkModel();
+  }
+  return link_a;
+}
+
+// ******************************************************************************************
+// Build the robot links connection graph and then check for links with no geomotry
+// ******************************************************************************************
+void computeConnectionGraph(const robot_model::LinkModel *start_link, LinkGraph &link_graph)
+{
+  link_graph.clear(); // make sure the edges structure is clear
+
+  // Recurively build adj list of link connections
+  computeConnectionGraphRec(start_link, link_graph);
+
+  // Repeatidly check for links with no geometry and remove them, then re-check until no more removals are detected
+  bool update = true; // track if a no geometry link was found
+  while (update)
+  {
+    update = false; // default
+
+    // Check if each edge has a shape
+    for (LinkGraph::const_iterator edge_it = link_graph.begin() ; edge_it != link_graph.end() ; ++edge_it)
+    {
+      if (edge_it->first->getShapes().empty()) // link in adjList "link_graph" does not have shape, remove!
+      {
+        // Temporary list for connected links
+        std::vector<const robot_model::LinkModel*> temp_list;
+
+        // Copy link's parent and child links to temp_list
+        for (std::set<const robot_model::LinkModel*>::const_iterator adj_it = edge_it->second.begin();
+             adj_it != edge_it->second.end();
+             ++adj_it)
+        {
+          temp_list.push_back(*adj_it);
+        }
+
+        // Make all preceeding and succeeding links to the no-shape link fully connected
         // so that they don't collision check with themselves
         for (std::size_t i = 0 ; i < temp_list.size() ; ++i)
         {
@@ -429,7 +1305,7 @@ void computeConnectionGraphRec(const robot_model::LinkModel *start_link, LinkGra
 // ******************************************************************************************
 // Disable collision checking for adjacent links, or adjacent with no geometry links between them
 // ******************************************************************************************
-unsigned int disableAdjacentLinks(planning_scene::PlanningScene &scene, LinkGraph &link_graph, LinkPairMap &link_pairs)
+unsigned int disableAdjacentLinks(planning_scene::PlanningScene &scene, LinkGraph &link_graph, LinkPairMatrix &link_pairs)
 {
   int num_disabled = 0;
   for (LinkGraph::const_iterator link_graph_it = link_graph.begin() ; link_graph_it != link_graph.end() ; ++link_graph_it)
@@ -460,13 +1336,16 @@ unsigned int disableAdjacentLinks(planning_scene::PlanningScene &scene, LinkGrap
 // ******************************************************************************************
 // Disable all collision checks that occur when the robot is started in its default state
 // ******************************************************************************************
-unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scene, LinkPairMap &link_pairs,
-                                      collision_detection::CollisionRequest &req)
+unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs,
+                                      collision_detection::CollisionRequest &req, DefaultCollisionsPhaseStats &stats)
 {
   // Setup environment
   collision_detection::CollisionResult res;
   scene.getCurrentStateNonConst().setToDefaultValues(); // set to default values of 0 OR half between low and high joint values
   scene.checkSelfCollision(req, res);
+  ++stats.collision_checks;
+  stats.contacts += res.contacts.size();
+  stats.max_contact_map_size = std::max(stats.max_contact_map_size, res.contacts.size());
 
   // For each collision in default state, always add to disabled links set
   int num_disabled = 0;
@@ -485,49 +1364,272 @@ unsigned int disableDefaultCollisions(planning_scene::PlanningScene &scene, Link
   return num_disabled;
 }
 
+// ******************************************************************************************
+// Disable link pairs that can never touch
+// ******************************************************************************************
+unsigned int disableUnreachableLinks(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs)
+{
+  // Geometry radius of every link of the matrix
+  std::vector<const robot_model::LinkModel*> links;
+  std::vector<double> link_radius;
+  computeLinkRadii(scene, link_pairs, links, link_radius);
+
+  // Depth of every link in the tree, for finding common parents
+  LinkDepthMap depth;
+  computeLinkDepths(*scene.getRobotModel(), depth);
+
+  unsigned int num_disabled = 0;
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+  {
+    if (link_pairs.disabled(index))
+      continue;
+
+    const int a = link_pairs.firstLink(index);
+    const int b = link_pairs.secondLink(index);
+    const robot_model::LinkModel *link_a = links[a];
+    const robot_model::LinkModel *link_b = links[b];
+    if (computeReachGap(link_a, link_b, link_radius[a], link_radius[b], depth) > 0.0)
+    {
+      num_disabled += link_pairs.setLinkPair(index, UNREACHABLE);
+
+      // disable link checking in the collision matrix
+      scene.getAllowedCollisionMatrixNonConst().setEntry(link_a->getName(), link_b->getName(), true);
+    }
+  }
+  //ROS_INFO("Disabled %d link pairs that are out of reach", num_disabled);
+
+  return num_disabled;
+}
+
+// ******************************************************************************************
+// Find the links of a link pair matrix and the radius of their geometry
+// ******************************************************************************************
+void computeLinkRadii(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                      std::vector<const robot_model::LinkModel*> &links, std::vector<double> &link_radius)
+{
+  links.resize(link_pairs.linkCount());
+  link_radius.resize(link_pairs.linkCount());
+  for (std::size_t i = 0 ; i < links.size() ; ++i)
+  {
+    const std::string &name = link_pairs.linkName(i);
+    links[i] = scene.getRobotModel()->getLinkModel(name);
+    link_radius[i] = computeLinkRadius(links[i], scene.getCollisionRobot()->getLinkPadding(name),
+                                       scene.getCollisionRobot()->getLinkScale(name));
+  }
+}
+
+// ******************************************************************************************
+// Lower bound on the distance of two links over all joint values
+// ******************************************************************************************
+double computeReachGap(const robot_model::LinkModel *link_a, const robot_model::LinkModel *link_b,
+                       double radius_a, double radius_b, const LinkDepthMap &depth)
+{
+  if (radius_a < 0.0 || radius_b < 0.0)
+    return -std::numeric_limits<double>::infinity();
+
+  // Common parent link, both links move relative to it only through the joints between them
+  const robot_model::LinkModel *parent = findCommonParent(link_a, link_b, depth);
+
+  Eigen::Vector3d center_a, center_b;
+  double reach_a, reach_b;
+  if (!computeReachSphere(link_a, parent, radius_a, center_a, reach_a) ||
+      !computeReachSphere(link_b, parent, radius_b, center_b, reach_b))
+    return -std::numeric_limits<double>::infinity();
+
+  return (center_a - center_b).norm() - reach_a - reach_b;
+}
+
+// ******************************************************************************************
+// Compute a sphere that contains every position a link can reach relative to one of its parent links
+// ******************************************************************************************
+bool computeReachSphere(const robot_model::LinkModel *link, const robot_model::LinkModel *parent,
+                        double link_radius, Eigen::Vector3d &center, double &radius)
+{
+  // The link does not move relative to itself
+  radius = link_radius;
+  center = Eigen::Vector3d::Zero();
+  if (link == parent)
+    return true;
+
+  // Walk up to the child of parent. Rotations keep the distance to the joint origin, so the translations between
+  // joint origins and the travel of prismatic joints add up to the reach
+  for (const robot_model::LinkModel *l = link ; l != parent ; l = l->getParentLinkModel())
+  {
+    const robot_model::JointModel *joint = l->getParentJointModel();
+    switch (joint->getType())
+    {
+      case robot_model::JointModel::REVOLUTE:
+      case robot_model::JointModel::FIXED:
+        break;
+      case robot_model::JointModel::PRISMATIC:
+        radius += std::max(std::abs(joint->getVariableBounds()[0].min_position_),
+                           std::abs(joint->getVariableBounds()[0].max_position_));
+        break;
+      default:
+        return false; // planar and floating joints have no bounded reach
+    }
+
+    if (l->getParentLinkModel() == parent)
+      center = l->getJointOriginTransform().translation(); // the first joint turns around this point
+    else
+      radius += l->getJointOriginTransform().translation().norm();
+  }
+
+  return true;
+}
+
+// ******************************************************************************************
+// Radius of a sphere around the origin of a link that contains all of its collision geometry
+// ******************************************************************************************
+double computeLinkRadius(const robot_model::LinkModel *link, double padding, double scale)
+{
+  double radius = 0.0;
+  for (std::size_t i = 0 ; i < link->getShapes().size() ; ++i)
+  {
+    double shape_radius = computeShapeRadius(link->getShapes()[i].get(), padding, scale);
+    if (shape_radius < 0.0)
+      return -1.0;
+
+    radius = std::max(radius, link->getCollisionOriginTransforms()[i].translation().norm() + shape_radius);
+  }
+
+  return radius;
+}
+
+// ******************************************************************************************
+// Radius of a sphere around the origin of a shape that contains the scaled and padded shape
+// ******************************************************************************************
+double computeShapeRadius(const shapes::Shape *shape, double padding, double scale)
+{
+  switch (shape->type)
+  {
+    case shapes::SPHERE:
+      return static_cast<const shapes::Sphere*>(shape)->radius * scale + padding;
+    case shapes::BOX:
+    {
+      // The padding is added on every side
+      const double *size = static_cast<const shapes::Box*>(shape)->size;
+      Eigen::Vector3d half(size[0], size[1], size[2]);
+      half = 0.5 * scale * half + Eigen::Vector3d::Constant(padding);
+      return half.norm();
+    }
+    case shapes::CYLINDER:
+    {
+      const shapes::Cylinder *cylinder = static_cast<const shapes::Cylinder*>(shape);
+      return Eigen::Vector2d(cylinder->radius * scale + padding, 0.5 * cylinder->length * scale + padding).norm();
+    }
+    case shapes::CONE:
+    {
+      const shapes::Cone *cone = static_cast<const shapes::Cone*>(shape);
+      return Eigen::Vector2d(cone->radius * scale + padding, 0.5 * cone->length * scale + padding).norm();
+    }
+    case shapes::MESH:
+    {
+      // Meshes are scaled about the mean of their vertices, not about their origin, and every vertex moves away from
+      // that center by the padding. The scaled bounding box of the vertices contains the scaled mesh
+      const shapes::Mesh *mesh = static_cast<const shapes::Mesh*>(shape);
+      if (mesh->vertex_count == 0)
+        return 0.0;
+      Eigen::Vector3d center = Eigen::Vector3d::Zero();
+      Eigen::Vector3d min_corner = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+      Eigen::Vector3d max_corner = -min_corner;
+      for (unsigned int i = 0 ; i < mesh->vertex_count ; ++i)
+      {
+        const Eigen::Vector3d v(mesh->vertices[3 * i], mesh->vertices[3 * i + 1], mesh->vertices[3 * i + 2]);
+        center += v;
+        min_corner = min_corner.cwiseMin(v);
+        max_corner = max_corner.cwiseMax(v);
+      }
+      center /= mesh->vertex_count;
+
+      double max_squared = 0.0;
+      for (int corner = 0 ; corner < 8 ; ++corner)
+      {
+        const Eigen::Vector3d v((corner & 1) ? max_corner.x() : min_corner.x(),
+                                (corner & 2) ? max_corner.y() : min_corner.y(),
+                                (corner & 4) ? max_corner.z() : min_corner.z());
+        max_squared = std::max(max_squared, (center + scale * (v - center)).squaredNorm());
+      }
+      return std::sqrt(max_squared) + padding;
+    }
+    default:
+      return -1.0; // planes, octrees and unknown shapes
+  }
+}
+
 // ******************************************************************************************
 // Compute the links that are always in collision
 // ******************************************************************************************
-unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, LinkPairMap &link_pairs,
-                                      collision_detection::CollisionRequest &req, StringPairSet &links_seen_colliding,
-                                      double min_collision_faction)
+unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, LinkPairMatrix &link_pairs,
+                                      collision_detection::CollisionRequest &req, PairBitset &links_seen_colliding,
+                                      const JointSpaceSampler &sampler, DefaultCollisionsProgress &progress,
+                                      DefaultCollisionsStats &stats, double min_collision_faction)
 {
   // Trial count variables
   static const unsigned int small_trial_count = 200;
-  static const unsigned int small_trial_limit = (unsigned int)((double)small_trial_count * min_collision_faction);
+  const unsigned int small_trial_limit = (unsigned int)((double)small_trial_count * min_collision_faction);
 
   bool done = false;
   unsigned int num_disabled = 0;
+  unsigned int sample_index = 0; // position in the sequence of the sampler
+
+  const int num_threads = stats.threads;
+
+  // Number of collisions per pair index, summed over all threads every round
+  std::vector<unsigned int> collision_count(link_pairs.pairCount());
+
+  // Every thread counts the collisions of its samples separately
+  std::vector<std::vector<unsigned int> > thread_collision_count(num_threads,
+                                                                 std::vector<unsigned int>(link_pairs.pairCount()));
+  boost::scoped_array<bool> thread_max_contacts_reached(new bool[num_threads]);
+  std::vector<ThreadStats> thread_stats(num_threads);
+  std::vector<ThreadScratch> thread_scratch(num_threads);
 
   while (!done)
   {
     // DO 'small_trial_count' COLLISION CHECKS AND RECORD STATISTICS ---------------------------------------
-    std::map<std::pair<std::string, std::string>, unsigned int> collision_count;
-
-    // Do a large number of tests
-    for (unsigned int i = 0 ; i < small_trial_count ; ++i)
+    // The threads take the samples of the round one by one, a sample is far more work than taking it
+    TrialQueue samples(sample_index, small_trial_count);
+    WorkerPool::TaskGroup group; // tasks for the threads of the pool
+    for(int i = 0; i < num_threads; ++i)
     {
-      // Check for collisions
-      collision_detection::CollisionResult res;
-      scene.getCurrentStateNonConst().setToRandomPositions();
-      scene.checkSelfCollision(req, res);
+      std::fill(thread_collision_count[i].begin(), thread_collision_count[i].end(), 0);
+      thread_max_contacts_reached[i] = false;
+      thread_stats[i] = ThreadStats();
+      AlwaysThreadComputation tc(scene, req, link_pairs, sampler, &samples, &thread_collision_count[i],
+                                 &thread_max_contacts_reached[i], &thread_scratch[i], &progress, &thread_stats[i]);
+      group.submit( boost::bind( &disableAlwaysInCollisionThread, tc ) );
+    }
 
-      // Sum the number of collisions
-      unsigned int nc = 0;
-      for (collision_detection::CollisionResult::ContactMap::const_iterator it = res.contacts.begin() ;
-           it != res.contacts.end() ; ++it)
-      {
-        collision_count[it->first]++;
-        links_seen_colliding.insert(it->first);
-        nc += it->second.size();
-      }
+    group.wait(); // wait for all tasks to finish
+    sample_index += small_trial_count;
+    reduceThreadStats(thread_stats, stats.phases[PHASE_ALWAYS], stats);
 
-      // Check if the number of contacts is greater than the max count
-      if (nc >= req.max_contacts)
-      {
-        req.max_contacts *= 2; // double the max contacts that the CollisionRequest checks for
-        //ROS_INFO("Doubling max_contacts to %d", int(req.max_contacts));
-      }
+    // The counts of an interrupted round are incomplete
+    if (progress.isCancelled())
+      break;
+
+    // Reduce the per-thread counts
+    std::fill(collision_count.begin(), collision_count.end(), 0);
+    bool max_contacts_reached = false;
+    for (int i = 0 ; i < num_threads ; ++i)
+    {
+      for (std::size_t index = 0 ; index < collision_count.size() ; ++index)
+        collision_count[index] += thread_collision_count[i][index];
+      max_contacts_reached |= thread_max_contacts_reached[i];
+    }
+    for (std::size_t index = 0 ; index < collision_count.size() ; ++index)
+    {
+      if (collision_count[index] > 0)
+        links_seen_colliding.set(index);
+    }
+
+    // Check if the number of contacts is greater than the max count
+    if (max_contacts_reached)
+    {
+      req.max_contacts *= 2; // double the max contacts that the CollisionRequest checks for
+      ++stats.max_contacts_doublings;
+      //ROS_INFO("Doubling max_contacts to %d", int(req.max_contacts));
     }
 
     // >= XX% OF TIME IN COLLISION DISABLE -----------------------------------------------------
@@ -535,16 +1637,16 @@ unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, Link
     int found = 0;
 
     // Loop through every pair of link collisions and disable if it meets the threshold
-    for (std::map<std::pair<std::string, std::string>, unsigned int>::const_iterator it = collision_count.begin() ;
-         it != collision_count.end() ; ++it)
+    for (std::size_t index = 0 ; index < collision_count.size() ; ++index)
     {
       // Disable these two links permanently
-      if (it->second > small_trial_limit)
+      if (collision_count[index] > small_trial_limit)
       {
-        num_disabled += setLinkPair( it->first.first, it->first.second, ALWAYS, link_pairs );
+        num_disabled += link_pairs.setLinkPair(index, ALWAYS);
 
         // disable link checking in the collision matrix
-        scene.getAllowedCollisionMatrixNonConst().setEntry(it->first.first, it->first.second, true);
+        scene.getAllowedCollisionMatrixNonConst().setEntry(link_pairs.linkName(link_pairs.firstLink(index)),
+                                                           link_pairs.linkName(link_pairs.secondLink(index)), true);
 
         found ++;
       }
@@ -555,47 +1657,436 @@ unsigned int disableAlwaysInCollision(planning_scene::PlanningScene &scene, Link
     if (found == 0)
       done = true;
 
+    progress.notify();
+
     //ROS_INFO("Disabled %u link pairs that are always in collision from collision checking", found);
   }
 
   return num_disabled;
 }
 
+// ******************************************************************************************
+// Thread for counting the collisions of each link pair in the samples it takes from a round of the always in
+// collision check
+// ******************************************************************************************
+void disableAlwaysInCollisionThread(AlwaysThreadComputation tc)
+{
+  ros::WallTime start_time = ros::WallTime::now();
+
+  // Kinematic state and result of this thread, kept from its previous rounds
+  reserveThreadScratch(*tc.scratch_, tc.scene_.getRobotModel(), 1);
+  robot_state::RobotState &kstate = tc.scratch_->states[0];
+  collision_detection::CollisionResult &res = tc.scratch_->result;
+
+  unsigned int i, count;
+  while (!tc.progress_->isCancelled() && tc.samples_->take(1, i, count))
+  {
+    // Check for collisions
+    res.clear();
+    tc.sampler_.sample(i, kstate);
+    tc.scene_.checkSelfCollision(tc.req_, res, kstate);
+
+    // Sum the number of collisions
+    unsigned int nc = 0;
+    for (collision_detection::CollisionResult::ContactMap::const_iterator it = res.contacts.begin() ;
+         it != res.contacts.end() ; ++it)
+    {
+      std::size_t index;
+      if (tc.link_pairs_.pairIndex(it->first.first, it->first.second, index))
+        (*tc.collision_count_)[index]++;
+      nc += it->second.size();
+    }
+
+    // Check if the number of contacts is greater than the max count
+    if (nc >= tc.req_.max_contacts)
+      *tc.max_contacts_reached_ = true;
+
+    tc.progress_->addSamples(1);
+    tc.stats_->samples++;
+    tc.stats_->contacts += res.contacts.size();
+    tc.stats_->max_contact_map_size = std::max(tc.stats_->max_contact_map_size, res.contacts.size());
+  }
+
+  tc.stats_->busy_time = (ros::WallTime::now() - start_time).toSec();
+}
+
 // ******************************************************************************************
 // Get the pairs of links that are never in collision
 // ******************************************************************************************
-unsigned int disableNeverInCollision(const unsigned int num_trials, planning_scene::PlanningScene &scene,
-                                     LinkPairMap &link_pairs, const collision_detection::CollisionRequest &req,
-                                     StringPairSet &links_seen_colliding, unsigned int *progress)
+unsigned int disableNeverInCollision(const DefaultCollisionsRequest &request, planning_scene::PlanningScene &scene,
+                                     LinkPairMatrix &link_pairs, const collision_detection::CollisionRequest &req,
+                                     PairBitset &links_seen_colliding, const JointSpaceSampler &sampler,
+                                     DefaultCollisionsProgress &progress, DefaultCollisionsReport &report)
 {
-  unsigned int num_disabled = 0;
+  // Trials are done in rounds, the results of all threads are merged and the stopping criterion checked in between
+  static const unsigned int round_size = 1000;
 
-  boost::thread_group bgroup; // create a group of threads
-  boost::mutex lock; // used for sharing the same data structures
+  unsigned int num_disabled = 0;
+  const unsigned int num_trials = request.trials;
 
-  int num_threads = boost::thread::hardware_concurrency(); // how many cores does this computer have?
+  const int num_threads = report.stats.threads;
   //ROS_INFO_STREAM("Performing " << num_trials << " trials for 'always in collision' checking on " <<
   //   num_threads << " threads...");
 
-  for(int i = 0; i < num_threads; ++i)
+  // Every thread collects the pairs it sees colliding in its own list, so no locking is needed while sampling
+  std::vector<PairDiscoveries> thread_discoveries(num_threads);
+  std::vector<ThreadStats> thread_stats(num_threads);
+  std::vector<ThreadScratch> thread_scratch(num_threads);
+
+  // Collisions per pair index of every thread in a round, summed up after every complete round
+  const bool count_collisions = request.record_collision_frequency || request.max_collision_frequency > 0.0;
+  std::vector<unsigned int> collision_count;
+  std::vector<std::vector<unsigned int> > thread_collision_count;
+  if (count_collisions)
+  {
+    collision_count.resize(link_pairs.pairCount(), 0);
+    thread_collision_count.resize(num_threads, collision_count);
+  }
+
+  // Report every colliding pair of a sample. A truncated contact list would make the pairs found depend on which
+  // pairs a thread has already masked, and with that on the number of threads
+  collision_detection::CollisionRequest never_req = req;
+  never_req.max_contacts = std::max<std::size_t>(never_req.max_contacts, link_pairs.pairCount());
+
+  // Trial after which each pair was seen colliding for the first time
+  std::vector<unsigned int> first_collision(link_pairs.pairCount(), 0);
+
+  // Smallest distance of every pair and the pairs that came closer than the margin, merged after every round
+  const bool check_near_misses = request.near_miss_margin > 0.0;
+  NearMissChecks near_miss;
+  std::vector<float> min_distance;
+  std::vector<std::vector<float> > thread_min_distance;
+  PairBitset near_pairs(link_pairs.pairCount());
+  if (check_near_misses)
+  {
+    prepareNearMissChecks(scene, link_pairs, links_seen_colliding, request.near_miss_margin, near_miss, min_distance);
+    thread_min_distance.resize(num_threads, min_distance);
+  }
+
+  // States in which the links of the undecided pairs came closest, the focused trials of a round start from the
+  // closest states of the previous rounds
+  const bool focus_trials = request.focus_fraction > 0.0;
+  FocusChecks focus;
+  FocusedSampler focused_sampler(scene.getRobotModel(), request.focus_radius, phaseSeed(request.seed, NEVER));
+  std::vector<ClosestState> closest;
+  std::vector<std::vector<ClosestState> > thread_closest(num_threads);
+  LinkDepthMap depth;
+  if (focus_trials)
+  {
+    focus.fraction = request.focus_fraction;
+    focus.links.resize(link_pairs.linkCount());
+    for (std::size_t i = 0 ; i < focus.links.size() ; ++i)
+      focus.links[i] = scene.getRobotModel()->getLinkModel(link_pairs.linkName(i));
+    closest.resize(link_pairs.pairCount());
+    computeLinkDepths(*scene.getRobotModel(), depth);
+  }
+
+  // Pair by pair checks skip the pairs that the scene allows to collide, just like the full self collision check
+  std::vector<std::size_t> check_pairs;
+  // The pair checkers also measure the distances of near miss candidates, one pair at a time
+  std::vector<boost::shared_ptr<LinkPairChecker> > pair_checkers;
+  if (request.pairwise_checks || check_near_misses)
+  {
+    std::vector<std::string> link_names(link_pairs.linkCount());
+    for (std::size_t i = 0 ; i < link_names.size() ; ++i)
+      link_names[i] = link_pairs.linkName(i);
+    for (int i = 0 ; i < num_threads ; ++i)
+      pair_checkers.push_back(boost::shared_ptr<LinkPairChecker>(new LinkPairChecker(scene, link_names)));
+  }
+  PairBitset allowed_pairs(link_pairs.pairCount());
+  if (request.pairwise_checks)
+  {
+
+    for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+    {
+      collision_detection::AllowedCollision::Type type;
+      if (scene.getAllowedCollisionMatrix().getAllowedCollision(link_pairs.linkName(link_pairs.firstLink(index)),
+                                                                link_pairs.linkName(link_pairs.secondLink(index)),
+                                                                type) &&
+          type == collision_detection::AllowedCollision::ALWAYS)
+        allowed_pairs.set(index);
+    }
+  }
+
+  // Continue after the last complete round of an interrupted run. Samples are indexed, so the number of trials done
+  // is all that is needed of the sampler
+  CollisionCheckpoint checkpoint;
+  const bool write_checkpoints = !request.checkpoint_path.empty();
+  if (write_checkpoints)
+    checkpoint.key = computeCheckpointKey(scene, request);
+  ros::WallTime last_checkpoint = ros::WallTime::now();
+
+  unsigned int trials_done = 0;
+  CollisionCheckpoint resumed;
+  if (write_checkpoints && request.resume && loadCollisionCheckpoint(request.checkpoint_path, resumed))
+  {
+    if (resumed.key != checkpoint.key || resumed.seen_colliding.size() != link_pairs.pairCount() ||
+        resumed.near_pairs.size() != link_pairs.pairCount() ||
+        resumed.collision_count.size() != collision_count.size() ||
+        resumed.min_distance.size() != min_distance.size() || resumed.closest_distance.size() != closest.size() ||
+        resumed.closest_trial.size() != closest.size() || resumed.closest_positions.size() != closest.size())
+    {
+      ROS_WARN_STREAM("Checkpoint " << request.checkpoint_path << " was written for another robot or other settings, "
+                      "starting the trials from the beginning");
+    }
+    else
+    {
+      trials_done = resumed.trials_done;
+      report.resumed_trials = resumed.trials_done;
+      report.focused_trials = resumed.focused_trials;
+      report.last_discovery = resumed.last_discovery;
+      links_seen_colliding |= resumed.seen_colliding;
+      near_pairs = resumed.near_pairs;
+      collision_count = resumed.collision_count;
+      min_distance = resumed.min_distance;
+      if (check_near_misses)
+        thread_min_distance.assign(num_threads, min_distance);
+
+      // The targets of the focused sampler follow from the closest states of the pairs that are still undecided
+      if (focus_trials)
+      {
+        for (std::size_t index = 0 ; index < closest.size() ; ++index)
+        {
+          closest[index].distance = resumed.closest_distance[index];
+          closest[index].trial = resumed.closest_trial[index];
+          closest[index].positions = resumed.closest_positions[index];
+        }
+        focus.pairs.clear();
+        for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+          if (!link_pairs.disabled(index) && !links_seen_colliding.test(index) && !near_pairs.test(index))
+            focus.pairs.push_back(index);
+        updateFocusTargets(link_pairs, links_seen_colliding | near_pairs, focus, closest, depth, focused_sampler);
+      }
+
+      progress.addResumedSamples(trials_done);
+      progress.setPairsResolved(countResolvedPairs(link_pairs, links_seen_colliding | near_pairs));
+      ROS_INFO_STREAM("Resuming the trials after trial " << trials_done);
+    }
+  }
+
+  while (trials_done < num_trials)
+  {
+    const unsigned int round_trials = std::min(round_size, num_trials - trials_done);
+
+    // Track the pairs that are still undecided in this round
+    if (focus_trials)
+    {
+      focus.pairs.clear();
+      for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+        if (!link_pairs.disabled(index) && !links_seen_colliding.test(index) && !near_pairs.test(index))
+          focus.pairs.push_back(index);
+      for (int i = 0 ; i < num_threads ; ++i)
+        thread_closest[i].assign(focus.pairs.size(), ClosestState());
+      focus.sampler = focused_sampler.getTargetCount() > 0 ? &focused_sampler : NULL;
+    }
+
+    // Compact list of the pairs the threads check one by one. Counting collisions needs every pair in every trial
+    if (request.pairwise_checks)
+    {
+      check_pairs.clear();
+      for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+        if (!link_pairs.disabled(index) && !allowed_pairs.test(index) &&
+            (count_collisions || !links_seen_colliding.test(index)))
+          check_pairs.push_back(index);
+    }
+
+    // The threads take the trials of the round batch by batch, so all of them stay busy until the round is done
+    const ros::WallTime round_start = ros::WallTime::now();
+    TrialQueue trials(trials_done, round_trials);
+    WorkerPool::TaskGroup group; // tasks for the threads of the pool
+    for(int i = 0; i < num_threads; ++i)
+    {
+      thread_discoveries[i].clear();
+      thread_stats[i] = ThreadStats();
+      ThreadComputation tc(scene, never_req, link_pairs, sampler, i, &trials, &links_seen_colliding,
+                           &thread_discoveries[i], count_collisions ? &thread_collision_count[i] : NULL,
+                           check_near_misses ? &near_miss : NULL, check_near_misses ? &thread_min_distance[i] : NULL,
+                           focus_trials ? &focus : NULL, focus_trials ? &thread_closest[i] : NULL,
+                           request.pairwise_checks ? &check_pairs : NULL,
+                           pair_checkers.empty() ? NULL : pair_checkers[i].get(), request.batch_size,
+                           &thread_scratch[i], &progress, &thread_stats[i]);
+      group.submit( boost::bind( &disableNeverInCollisionThread, tc ) );
+    }
+
+    group.wait(); // wait for all tasks to finish
+    reduceThreadStats(thread_stats, report.stats.phases[PHASE_NEVER], report.stats);
+    const double round_time = (ros::WallTime::now() - round_start).toSec();
+
+    // An interrupted round did not see all of its samples, so no pair may be disabled as never colliding. The
+    // complete rounds before it are kept for resuming
+    if (progress.isCancelled())
+    {
+      if (write_checkpoints)
+      {
+        fillCheckpoint(trials_done, report, links_seen_colliding, near_pairs, collision_count, min_distance, closest,
+                       checkpoint);
+        saveCollisionCheckpoint(request.checkpoint_path, checkpoint);
+      }
+      break;
+    }
+
+    // Reduce the per-thread results into the shared set. Threads skip pairs that were known at the start of the
+    // round, so every discovery is new and the earliest trial over all threads is the first collision of the pair
+    PairBitset round_seen_colliding(link_pairs.pairCount());
+    for (std::size_t i = 0 ; i < thread_discoveries.size() ; ++i)
+    {
+      for (PairDiscoveries::const_iterator it = thread_discoveries[i].begin() ; it != thread_discoveries[i].end() ; ++it)
+      {
+        if (!round_seen_colliding.test(it->first) || it->second < first_collision[it->first])
+          first_collision[it->first] = it->second;
+        round_seen_colliding.set(it->first);
+      }
+    }
+    for (std::size_t index = round_seen_colliding.find_first() ; index != PairBitset::npos ;
+         index = round_seen_colliding.find_next(index))
+      report.last_discovery = std::max(report.last_discovery, first_collision[index] + 1);
+    links_seen_colliding |= round_seen_colliding;
+
+    for (std::size_t i = 0 ; i < thread_collision_count.size() ; ++i)
+    {
+      for (std::size_t index = 0 ; index < collision_count.size() ; ++index)
+        collision_count[index] += thread_collision_count[i][index];
+      std::fill(thread_collision_count[i].begin(), thread_collision_count[i].end(), 0);
+    }
+
+    // The smallest distance over all threads decides whether a pair is a near miss
+    for (std::size_t k = 0 ; k < near_miss.pairs.size() ; ++k)
+    {
+      const std::size_t index = near_miss.pairs[k];
+      for (std::size_t i = 0 ; i < thread_min_distance.size() ; ++i)
+        min_distance[index] = std::min(min_distance[index], thread_min_distance[i][index]);
+      if (min_distance[index] <= near_miss.margin)
+        near_pairs.set(index);
+    }
+
+    // The closest state over all threads, ties go to the earlier trial, is where the next round focuses
+    if (focus_trials)
+    {
+      if (focus.sampler)
+        for (unsigned int trial = trials_done ; trial < trials_done + round_trials ; ++trial)
+          report.focused_trials += isFocusedTrial(trial, focus.fraction);
+
+      for (std::size_t k = 0 ; k < focus.pairs.size() ; ++k)
+      {
+        ClosestState &pair_closest = closest[focus.pairs[k]];
+        for (std::size_t i = 0 ; i < thread_closest.size() ; ++i)
+        {
+          const ClosestState &candidate = thread_closest[i][k];
+          if (candidate.distance < pair_closest.distance ||
+              (candidate.distance == pair_closest.distance && candidate.trial < pair_closest.trial))
+            pair_closest = candidate;
+        }
+      }
+      updateFocusTargets(link_pairs, links_seen_colliding | near_pairs, focus, closest, depth, focused_sampler);
+    }
+
+    trials_done += round_trials;
+    const std::size_t num_resolved = countResolvedPairs(link_pairs, links_seen_colliding | near_pairs);
+    progress.setPairsResolved(num_resolved);
+    progress.notify();
+
+    // Stop once it is unlikely that further trials find another colliding pair
+    report.discovery_rate_bound = discoveryRateBound(trials_done - report.last_discovery,
+                                                     request.termination_confidence);
+
+    // The bound holds for the mix of trials. Uniform trials make up at least 1 - focus_fraction of them, so their
+    // rate of new pairs is at most the bound divided by that share
+    if (report.focused_trials > 0)
+      report.discovery_rate_bound = std::min(1.0, report.discovery_rate_bound / (1.0 - focus.fraction));
+    if (request.max_discovery_rate > 0.0 && report.discovery_rate_bound <= request.max_discovery_rate)
+    {
+      report.stopped_early = trials_done < num_trials;
+      break;
+    }
+
+    // Once every pair left has collided, more trials cannot change a verdict. Typical for incremental runs, which
+    // only sample the pairs affected by a change
+    if (!count_collisions && num_resolved == link_pairs.pairCount())
+    {
+      report.stopped_early = trials_done < num_trials;
+      break;
+    }
+
+    // Only start another round if it finishes within the budget, assuming it takes as long as the last one
+    if (request.time_budget > 0.0 && trials_done < num_trials)
+    {
+      const double remaining_time = request.time_budget - progress.getElapsedTime();
+      if (remaining_time < round_time)
+      {
+        report.stopped_early = report.budget_exhausted = true;
+        break;
+      }
+      const double expected_trials = trials_done + round_trials * remaining_time / std::max(round_time, 1e-6);
+      progress.setSamplesTotal((unsigned int)std::min<double>(num_trials, expected_trials));
+    }
+
+    if (write_checkpoints && trials_done < num_trials &&
+        (ros::WallTime::now() - last_checkpoint).toSec() >= request.checkpoint_interval)
+    {
+      fillCheckpoint(trials_done, report, links_seen_colliding, near_pairs, collision_count, min_distance, closest,
+                     checkpoint);
+      saveCollisionCheckpoint(request.checkpoint_path, checkpoint);
+      last_checkpoint = ros::WallTime::now();
+    }
+  }
+  report.trials = trials_done;
+  if (progress.isCancelled())
+    return 0;
+
+  // The requested rate holds for the uniform trials, which are at least 1 - focus_fraction of the mix
+  if (request.max_discovery_rate > 0.0)
+  {
+    const double rate = report.focused_trials > 0 ? request.max_discovery_rate * (1.0 - focus.fraction) :
+                        request.max_discovery_rate;
+    report.confidence_reached = discoveryConfidence(trials_done - report.last_discovery, rate);
+  }
+
+  // Frequency of every pair that was checked in the trials, i.e. was not disabled before. Only the uniform trials
+  // count, focused trials look for collisions on purpose
+  const unsigned int uniform_trials = trials_done - report.focused_trials;
+  if (count_collisions && uniform_trials > 0)
   {
-    ThreadComputation tc(scene, req, i, num_trials/num_threads, &links_seen_colliding, &lock, progress);
-    bgroup.create_thread( boost::bind( &disableNeverInCollisionThread, tc ) );
+    for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+    {
+      if (link_pairs.disabled(index))
+        continue;
+
+      link_pairs.setCollisionFrequency(index, (double)collision_count[index] / uniform_trials);
+    }
   }
 
-  bgroup.join_all(); // wait for all threads to finish
+  // Smallest distance of every pair that was checked in the trials, colliding pairs touched
+  if (check_near_misses && trials_done > 0)
+  {
+    for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+    {
+      if (link_pairs.disabled(index))
+        continue;
+
+      if (links_seen_colliding.test(index))
+        link_pairs.setMinDistance(index, 0.0);
+      else if (min_distance[index] < std::numeric_limits<float>::infinity())
+        link_pairs.setMinDistance(index, min_distance[index]);
+    }
+  }
 
   // Loop through every possible link pair and check if it has ever been seen in collision
-  for ( LinkPairMap::iterator pair_it = link_pairs.begin() ; pair_it != link_pairs.end() ; ++pair_it)
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
   {
-    if( ! pair_it->second.disable_check ) // is not disabled yet
+    if( ! link_pairs.disabled(index) ) // is not disabled yet
     {
       // Check if current pair has been seen colliding ever. If it has never been seen colliding, add it to disabled list
-      if (links_seen_colliding.find( pair_it->first ) == links_seen_colliding.end())
+      if (!links_seen_colliding.test(index))
       {
+        // Pairs that came close without touching stay enabled
+        if (near_pairs.test(index))
+        {
+          ++report.near_misses;
+          continue;
+        }
+
         // Add to disabled list using pair ordering
-        pair_it->second.reason = NEVER;
-        pair_it->second.disable_check = true;
+        link_pairs.setLinkPair(index, NEVER);
 
         // Count it
         ++num_disabled;
@@ -604,6 +2095,22 @@ unsigned int disableNeverInCollision(const unsigned int num_trials, planning_sce
   }
   //ROS_INFO("Disabled %d link pairs that are never in collision", num_disabled);
 
+  // Disable the pairs that collided rarely enough for the user
+  if (request.max_collision_frequency > 0.0)
+  {
+    for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+    {
+      if (!link_pairs.disabled(index) && !near_pairs.test(index) && link_pairs.collisionFrequency(index) >= 0.0 &&
+          link_pairs.collisionFrequency(index) <= request.max_collision_frequency)
+      {
+        link_pairs.setLinkPair(index, RARELY);
+        scene.getAllowedCollisionMatrixNonConst().setEntry(link_pairs.linkName(link_pairs.firstLink(index)),
+                                                           link_pairs.linkName(link_pairs.secondLink(index)), true);
+        ++report.rarely_colliding;
+      }
+    }
+  }
+
   return num_disabled;
 }
 
@@ -612,44 +2119,606 @@ unsigned int disableNeverInCollision(const unsigned int num_trials, planning_sce
 // ******************************************************************************************
 void disableNeverInCollisionThread(ThreadComputation tc)
 {
-  //ROS_INFO_STREAM("Thread " << tc.thread_id_ << " running " << tc.num_trials_ << " trials");
+  //ROS_INFO_STREAM("Thread " << tc.thread_id_ << " started");
+
+  ros::WallTime start_time = ros::WallTime::now();
+
+  // Kinematic states for this thread to work on, one per trial of a batch, kept from its previous rounds. Batches only
+  // help pair by pair checks, which go through all states of a batch for one pair before the next pair
+  const unsigned int batch_size = tc.check_pairs_ ? std::max(1u, tc.batch_size_) : 1;
+  reserveThreadScratch(*tc.scratch_, tc.scene_.getRobotModel(), batch_size);
+  std::vector<robot_state::RobotState> &states = tc.scratch_->states;
+  std::vector<bool> focused(batch_size);
+  std::vector<std::size_t> contacts(batch_size);
+  collision_detection::CollisionResult &res = tc.scratch_->result; // cleared for every trial instead of allocated
+
+  // Private view of the allowed collision matrix. Pairs already known to collide are allowed so they are not
+  // reported again, which keeps the contact computation cheap as more pairs are found. When counting collisions,
+  // all pairs stay checked and a pair is only reported the first time this thread sees it
+  collision_detection::AllowedCollisionMatrix acm = tc.scene_.getAllowedCollisionMatrix();
+  PairBitset thread_seen_colliding;
+  if (tc.collision_count_)
+    thread_seen_colliding.resize(tc.link_pairs_.pairCount());
+  else
+  {
+    for (std::size_t index = tc.links_seen_colliding_->find_first() ; index != PairBitset::npos ;
+         index = tc.links_seen_colliding_->find_next(index))
+      acm.setEntry(tc.link_pairs_.linkName(tc.link_pairs_.firstLink(index)),
+                   tc.link_pairs_.linkName(tc.link_pairs_.secondLink(index)), true);
+  }
 
-  // User feedback vars
-  const unsigned int progress_interval = tc.num_trials_ / 20; // show progress update every 5%
+  // Pairs this thread saw colliding, their distance is 0 and not queried anymore
+  PairBitset thread_touched;
+  if (tc.near_miss_)
+    thread_touched.resize(tc.link_pairs_.pairCount());
 
-  // Create a new kinematic state for this thread to work on
-  robot_state::RobotState kstate(tc.scene_.getRobotModel());
+  // Pairs this thread still checks one by one, pairs it sees colliding are removed unless collisions are counted
+  std::vector<std::size_t> check_pairs;
+  if (tc.check_pairs_)
+    check_pairs = *tc.check_pairs_;
 
-  // Do a large number of tests
-  for (unsigned int i = 0 ; i < tc.num_trials_ ; ++i)
+  // Do a large number of tests, a batch at a time, until the round has no trials left
+  unsigned int first, count;
+  while (!tc.progress_->isCancelled() && tc.trials_->take(batch_size, first, count))
   {
-    // Status update at intervals and only for 0 thread
-    if(i % progress_interval == 0 && tc.thread_id_ == 0)
+    for (unsigned int s = 0 ; s < count ; ++s)
     {
-      //ROS_INFO("Collision checking %d%% complete", int(i * 100 / tc.num_trials_ ));
-      (*tc.progress_) = i * 92 / tc.num_trials_ + 8; // 8 is the amount of progress already completed in prev steps
+      focused[s] = tc.focus_ && tc.focus_->sampler && isFocusedTrial(first + s, tc.focus_->fraction);
+      if (focused[s])
+        tc.focus_->sampler->sample(first + s, states[s]);
+      else
+        tc.sampler_.sample(first + s, states[s]);
+      contacts[s] = 0;
     }
 
-    collision_detection::CollisionResult res;
-    kstate.setToRandomPositions();
-    tc.scene_.checkSelfCollision(tc.req_, res, kstate);
-
-    // Check all contacts
-    for (collision_detection::CollisionResult::ContactMap::const_iterator it = res.contacts.begin() ; it != res.contacts.end() ; ++it)
+    if (tc.check_pairs_)
     {
-      // Check if this collision pair is unique before doing a thread lock
-      if (tc.links_seen_colliding_->find( it->first ) == tc.links_seen_colliding_->end())
+      for (unsigned int s = 0 ; s < count ; ++s)
+        states[s].updateCollisionBodyTransforms();
+      tc.pair_checker_->setStates(states, count);
+
+      // Only the pairs in the list, nothing is done for links whose pairs are all decided. Each pair goes through
+      // the batch in trial order, so the first collision found is the earliest one
+      for (std::size_t k = 0 ; k < check_pairs.size() ; )
       {
-        // Collision Matrix and links_seen_colliding is modified only if needed, based on above if statement
+        const std::size_t index = check_pairs[k];
+        bool decided = false;
+        for (unsigned int s = 0 ; s < count && !decided ; ++s)
+        {
+          if (tc.pair_checker_->checkPair(tc.link_pairs_.firstLink(index), tc.link_pairs_.secondLink(index), s))
+          {
+            ++contacts[s];
+            decided = recordCollision(tc, index, first + s, focused[s], thread_seen_colliding, thread_touched);
+          }
+        }
 
-        boost::mutex::scoped_lock slock(*tc.lock_);
-        tc.links_seen_colliding_->insert(it->first);
+        if (decided)
+        {
+          check_pairs[k] = check_pairs.back(); // the order of the checks does not matter
+          check_pairs.pop_back();
+        }
+        else
+          ++k;
+      }
+    }
+    else
+    {
+      for (unsigned int s = 0 ; s < count ; ++s)
+      {
+        res.clear();
+        tc.scene_.checkSelfCollision(tc.req_, res, states[s], acm);
+        contacts[s] = res.contacts.size();
 
-        tc.scene_.getAllowedCollisionMatrixNonConst().setEntry(it->first.first, it->first.second, true); // disable link checking in the collision matrix
+        // Check all contacts
+        for (collision_detection::CollisionResult::ContactMap::const_iterator it = res.contacts.begin() ; it != res.contacts.end() ; ++it)
+        {
+          // Remember the pair and when it was seen, then stop checking it in this thread
+          std::size_t index;
+          if (tc.link_pairs_.pairIndex(it->first.first, it->first.second, index) &&
+              recordCollision(tc, index, first + s, focused[s], thread_seen_colliding, thread_touched))
+            acm.setEntry(it->first.first, it->first.second, true); // disable link checking in the collision matrix
+        }
       }
+    }
+
+    for (unsigned int s = 0 ; s < count ; ++s)
+    {
+      if (tc.near_miss_)
+        tc.stats_->distance_queries += checkNearMisses(tc, states[s], thread_touched);
+
+      if (tc.focus_)
+        trackClosestStates(tc, states[s], first + s);
 
+      tc.stats_->contacts += contacts[s];
+      tc.stats_->max_contact_map_size = std::max(tc.stats_->max_contact_map_size, contacts[s]);
     }
+    tc.progress_->addSamples(count);
+    tc.stats_->samples += count;
   }
+
+  tc.stats_->busy_time = (ros::WallTime::now() - start_time).toSec();
+}
+
+// ******************************************************************************************
+// Count a colliding pair of a never in collision trial
+// ******************************************************************************************
+bool recordCollision(const ThreadComputation &tc, std::size_t index, unsigned int trial, bool focused,
+                     PairBitset &thread_seen_colliding, PairBitset &thread_touched)
+{
+  if (tc.near_miss_)
+    thread_touched.set(index);
+
+  // Counted pairs stay checked, they are only reported the first time
+  if (tc.collision_count_)
+  {
+    if (!focused)
+      (*tc.collision_count_)[index]++;
+    if (tc.links_seen_colliding_->test(index) || thread_seen_colliding.test(index))
+      return false;
+    thread_seen_colliding.set(index);
+    tc.discoveries_->push_back(std::make_pair(index, trial));
+    return false;
+  }
+
+  tc.discoveries_->push_back(std::make_pair(index, trial));
+  return true;
+}
+
+// ******************************************************************************************
+// Select the pairs that get distance queries in the never in collision check
+// ******************************************************************************************
+void prepareNearMissChecks(const planning_scene::PlanningScene &scene, const LinkPairMatrix &link_pairs,
+                           const PairBitset &links_seen_colliding, double margin, NearMissChecks &checks,
+                           std::vector<float> &min_distance)
+{
+  checks.margin = margin;
+  computeLinkRadii(scene, link_pairs, checks.links, checks.link_radius);
+  min_distance.assign(link_pairs.pairCount(), std::numeric_limits<float>::infinity());
+
+  LinkDepthMap depth;
+  computeLinkDepths(*scene.getRobotModel(), depth);
+
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+  {
+    if (link_pairs.disabled(index) || links_seen_colliding.test(index))
+      continue;
+
+    const int a = link_pairs.firstLink(index);
+    const int b = link_pairs.secondLink(index);
+
+    // The reach of the links proves a lower bound on their distance, no sample can come closer
+    const double gap = computeReachGap(checks.links[a], checks.links[b], checks.link_radius[a],
+                                       checks.link_radius[b], depth);
+    if (gap > margin)
+    {
+      min_distance[index] = gap;
+      continue;
+    }
+
+    checks.pairs.push_back(index);
+  }
+}
+
+// ******************************************************************************************
+// Update the smallest distances of the near miss candidates in one sample
+// ******************************************************************************************
+unsigned int checkNearMisses(const ThreadComputation &tc, const robot_state::RobotState &kstate,
+                             const PairBitset &thread_touched)
+{
+  const NearMissChecks &checks = *tc.near_miss_;
+  std::vector<float> &min_distance = *tc.min_distance_;
+
+  unsigned int queries = 0;
+  for (std::size_t k = 0 ; k < checks.pairs.size() ; ++k)
+  {
+    // Pairs that touched have distance 0. Pairs that only came close are still queried, so that their smallest
+    // distance does not depend on which thread saw which sample first
+    const std::size_t index = checks.pairs[k];
+    if (tc.links_seen_colliding_->test(index) || thread_touched.test(index))
+      continue;
+
+    // Distance of the bounding spheres around the link origins, a lower bound of the distance of the geometry
+    const int a = tc.link_pairs_.firstLink(index);
+    const int b = tc.link_pairs_.secondLink(index);
+    double distance = -std::numeric_limits<double>::infinity();
+    if (checks.link_radius[a] >= 0.0 && checks.link_radius[b] >= 0.0)
+      distance = (kstate.getGlobalLinkTransform(checks.links[a]).translation() -
+                  kstate.getGlobalLinkTransform(checks.links[b]).translation()).norm() -
+                 checks.link_radius[a] - checks.link_radius[b];
+
+    // Only pairs that may be closer than the margin need the exact distance, measured on the shapes of the two links
+    // without a broadphase over the whole robot
+    if (distance <= checks.margin)
+    {
+      distance = tc.pair_checker_->distancePair(a, b, kstate);
+      ++queries;
+    }
+
+    min_distance[index] = std::min(min_distance[index], (float)distance);
+  }
+
+  return queries;
+}
+
+// ******************************************************************************************
+// Whether a trial of the never in collision check focuses on undecided pairs
+// ******************************************************************************************
+bool isFocusedTrial(unsigned int trial, double fraction)
+{
+  // The trials where the running count of focused trials steps up
+  return std::floor((trial + 1.0) * fraction) > std::floor(trial * fraction);
+}
+
+// ******************************************************************************************
+// Collect the joints that move two links relative to each other
+// ******************************************************************************************
+void computePairJoints(const robot_model::LinkModel *link_a, const robot_model::LinkModel *link_b,
+                       const LinkDepthMap &depth, std::vector<const robot_model::JointModel*> &joints)
+{
+  const robot_model::LinkModel *parent = findCommonParent(link_a, link_b, depth);
+
+  std::set<const robot_model::JointModel*> added;
+  const robot_model::LinkModel *pair_links[2] = { link_a, link_b };
+  for (int i = 0 ; i < 2 ; ++i)
+  {
+    for (const robot_model::LinkModel *l = pair_links[i] ; l != parent ; l = l->getParentLinkModel())
+    {
+      const robot_model::JointModel *joint = l->getParentJointModel();
+      if (joint->getMimic())
+        joint = joint->getMimic(); // setting the followed joint moves the mimic joint too
+      if (joint->getVariableCount() > 0 && added.insert(joint).second)
+        joints.push_back(joint);
+    }
+  }
+}
+
+// ******************************************************************************************
+// Remember the sample in which the links of each undecided pair came closest
+// ******************************************************************************************
+void trackClosestStates(const ThreadComputation &tc, const robot_state::RobotState &kstate, unsigned int trial)
+{
+  const FocusChecks &focus = *tc.focus_;
+  const std::size_t variable_count = tc.scene_.getRobotModel()->getVariableCount();
+
+  for (std::size_t k = 0 ; k < focus.pairs.size() ; ++k)
+  {
+    const robot_model::LinkModel *link_a = focus.links[tc.link_pairs_.firstLink(focus.pairs[k])];
+    const robot_model::LinkModel *link_b = focus.links[tc.link_pairs_.secondLink(focus.pairs[k])];
+    const double distance = (kstate.getGlobalLinkTransform(link_a).translation() -
+                             kstate.getGlobalLinkTransform(link_b).translation()).norm();
+
+    // Trials of a thread increase, so the first of equally close states is kept
+    ClosestState &pair_closest = (*tc.closest_)[k];
+    if (distance < pair_closest.distance)
+    {
+      pair_closest.distance = distance;
+      pair_closest.trial = trial;
+      pair_closest.positions.assign(kstate.getVariablePositions(), kstate.getVariablePositions() + variable_count);
+    }
+  }
+}
+
+// ******************************************************************************************
+// Focus the sampler on the undecided pairs
+// ******************************************************************************************
+void updateFocusTargets(const LinkPairMatrix &link_pairs, const PairBitset &decided, const FocusChecks &focus,
+                        const std::vector<ClosestState> &closest, const LinkDepthMap &depth,
+                        FocusedSampler &sampler)
+{
+  std::vector<FocusedSampler::Target> targets;
+  for (std::size_t k = 0 ; k < focus.pairs.size() ; ++k)
+  {
+    const std::size_t index = focus.pairs[k];
+    if (decided.test(index) || closest[index].positions.empty())
+      continue;
+
+    FocusedSampler::Target target;
+    computePairJoints(focus.links[link_pairs.firstLink(index)], focus.links[link_pairs.secondLink(index)], depth,
+                      target.joints_);
+    if (target.joints_.empty())
+      continue; // nothing moves the links relative to each other
+
+    target.positions_ = closest[index].positions;
+    targets.push_back(target);
+  }
+
+  sampler.setTargets(targets);
+}
+
+// ******************************************************************************************
+// Add states to the buffers of a thread until there are enough
+// ******************************************************************************************
+void reserveThreadScratch(ThreadScratch &scratch, const robot_model::RobotModelConstPtr &model,
+                          std::size_t state_count)
+{
+  while (scratch.states.size() < state_count)
+    scratch.states.push_back(robot_state::RobotState(model));
+}
+
+// ******************************************************************************************
+// Derive the seed of the sampler of one phase from the seed of the computation
+// ******************************************************************************************
+int phaseSeed(int seed, DisabledReason phase)
+{
+  if (seed < 0)
+    return seed;
+
+  // Different but fixed sequences for the phases, kept non-negative
+  return (int)(((unsigned int)seed * 31u + (unsigned int)phase + 1u) & 0x7fffffffu);
+}
+
+// ******************************************************************************************
+// Upper bound on the probability that a trial reveals a new colliding pair
+// ******************************************************************************************
+double discoveryRateBound(unsigned int trials_without_discovery, double confidence)
+{
+  // If every trial found a new pair with probability p, seeing none in n trials has probability (1-p)^n.
+  // The bound is the p for which this drops to 1 - confidence
+  if (trials_without_discovery == 0)
+    return 1.0;
+  return 1.0 - std::pow(1.0 - confidence, 1.0 / trials_without_discovery);
+}
+
+// ******************************************************************************************
+// Confidence that the probability of a trial revealing a new colliding pair is at most a rate
+// ******************************************************************************************
+double discoveryConfidence(unsigned int trials_without_discovery, double rate)
+{
+  // A rate above the true one would have shown a new pair in n trials with probability 1 - (1-rate)^n
+  return 1.0 - std::pow(1.0 - std::min(rate, 1.0), (double)trials_without_discovery);
+}
+
+// ******************************************************************************************
+// Count the pairs whose verdict is known
+// ******************************************************************************************
+std::size_t countResolvedPairs(const LinkPairMatrix &link_pairs, const PairBitset &links_seen_colliding)
+{
+  std::size_t num_resolved = 0;
+  for (std::size_t index = 0 ; index < link_pairs.pairCount() ; ++index)
+  {
+    if (link_pairs.disabled(index) || links_seen_colliding.test(index))
+      ++num_resolved;
+  }
+  return num_resolved;
+}
+
+// ******************************************************************************************
+// Hash of the robot and all settings the never in collision trials depend on
+// ******************************************************************************************
+boost::uint64_t computeCheckpointKey(const planning_scene::PlanningScene &scene,
+                                     const DefaultCollisionsRequest &request)
+{
+  // The sample sequence depends on the sampler and its seed, the focused trials on the closest states
+  ContentHash key;
+  hashRequestSettings(request, key);
+  key.add((boost::uint64_t)request.sampler).add((boost::uint64_t)(boost::int64_t)request.seed);
+  key.add((boost::uint64_t)request.record_collision_frequency).add(request.focus_fraction).add(request.focus_radius);
+
+  // Links without geometry move the others, so all links count
+  LinkHashMap link_hashes;
+  computeLinkHashes(scene, link_hashes);
+  for (LinkHashMap::const_iterator it = link_hashes.begin() ; it != link_hashes.end() ; ++it)
+    key.add(it->first).add(it->second.geometry).add(it->second.joint);
+
+  return key.value();
+}
+
+// ******************************************************************************************
+// Copy the state of the never in collision trials after a complete round into a checkpoint
+// ******************************************************************************************
+void fillCheckpoint(unsigned int trials_done, const DefaultCollisionsReport &report,
+                    const PairBitset &links_seen_colliding, const PairBitset &near_pairs,
+                    const std::vector<unsigned int> &collision_count, const std::vector<float> &min_distance,
+                    const std::vector<ClosestState> &closest, CollisionCheckpoint &checkpoint)
+{
+  checkpoint.trials_done = trials_done;
+  checkpoint.focused_trials = report.focused_trials;
+  checkpoint.last_discovery = report.last_discovery;
+  checkpoint.seen_colliding = links_seen_colliding;
+  checkpoint.near_pairs = near_pairs;
+  checkpoint.collision_count = collision_count;
+  checkpoint.min_distance = min_distance;
+
+  checkpoint.closest_distance.resize(closest.size());
+  checkpoint.closest_trial.resize(closest.size());
+  checkpoint.closest_positions.resize(closest.size());
+  for (std::size_t index = 0 ; index < closest.size() ; ++index)
+  {
+    checkpoint.closest_distance[index] = closest[index].distance;
+    checkpoint.closest_trial[index] = closest[index].trial;
+    checkpoint.closest_positions[index] = closest[index].positions;
+  }
+}
+
+// ******************************************************************************************
+// Add the counters of the threads of a round to the statistics of a phase
+// ******************************************************************************************
+void reduceThreadStats(const std::vector<ThreadStats> &thread_stats, DefaultCollisionsPhaseStats &phase_stats,
+                       DefaultCollisionsStats &stats)
+{
+  if (stats.thread_samples.size() < thread_stats.size())
+  {
+    stats.thread_samples.resize(thread_stats.size(), 0);
+    stats.thread_busy_time.resize(thread_stats.size(), 0.0);
+  }
+
+  double slowest = 0.0;
+  for (std::size_t i = 0 ; i < thread_stats.size() ; ++i)
+  {
+    phase_stats.collision_checks += thread_stats[i].samples;
+    phase_stats.contacts += thread_stats[i].contacts;
+    phase_stats.max_contact_map_size = std::max(phase_stats.max_contact_map_size,
+                                                thread_stats[i].max_contact_map_size);
+    phase_stats.distance_queries += thread_stats[i].distance_queries;
+    stats.thread_samples[i] += thread_stats[i].samples;
+    stats.thread_busy_time[i] += thread_stats[i].busy_time;
+    slowest = std::max(slowest, thread_stats[i].busy_time);
+  }
+
+  // All threads of a round are joined before the next round starts
+  for (std::size_t i = 0 ; i < thread_stats.size() ; ++i)
+    stats.barrier_wait_time += slowest - thread_stats[i].busy_time;
+}
+
+// ******************************************************************************************
+// CPU time of the process in seconds
+// ******************************************************************************************
+double processCpuTime()
+{
+  timespec time;
+  if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+    return 0.0;
+  return time.tv_sec + 1e-9 * time.tv_nsec;
+}
+
+// ******************************************************************************************
+// Measures the wall clock and CPU time of a phase
+// ******************************************************************************************
+PhaseTimer::PhaseTimer(DefaultCollisionsPhaseStats &stats)
+  : stats_(stats), wall_start_(ros::WallTime::now()), cpu_start_(processCpuTime())
+{
+}
+
+void PhaseTimer::stop()
+{
+  stats_.wall_time += (ros::WallTime::now() - wall_start_).toSec();
+  stats_.cpu_time += processCpuTime() - cpu_start_;
+}
+
+// ******************************************************************************************
+// Write the progress in percent to the legacy progress variable
+// ******************************************************************************************
+void copyProgressPercent(const DefaultCollisionsProgress &progress, unsigned int *percent)
+{
+  *percent = progress.getPercent();
+}
+
+// ******************************************************************************************
+// Progress of a computeDefaultCollisions() run
+// ******************************************************************************************
+DefaultCollisionsProgress::DefaultCollisionsProgress()
+  : cancelled_(false), samples_checked_(0), phase_samples_begin_(0), samples_resumed_(0), phase_(PHASE_SETUP),
+    percent_begin_(0), percent_end_(0), samples_total_(0), pairs_resolved_(0), pairs_total_(0)
+{
+  start_time_ = phase_start_time_ = ros::WallTime::now().toSec();
+}
+
+void DefaultCollisionsProgress::setCallback(const Callback &callback)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  callback_ = callback;
+}
+
+DefaultCollisionsPhase DefaultCollisionsProgress::getPhase() const
+{
+  return phase_;
+}
+
+unsigned int DefaultCollisionsProgress::getPercent() const
+{
+  const unsigned int samples_total = samples_total_;
+  const unsigned int percent_begin = percent_begin_;
+  const unsigned int percent_end = std::max<unsigned int>(percent_end_, percent_begin);
+  if (samples_total == 0)
+    return percent_begin;
+
+  // Interpolate within the phase, the last round may be cut short by early termination
+  unsigned int samples_done = std::min(getSamplesDone(), samples_total);
+  return percent_begin + (unsigned long)(percent_end - percent_begin) * samples_done / samples_total;
+}
+
+unsigned int DefaultCollisionsProgress::getSamplesTotal() const
+{
+  return samples_total_;
+}
+
+std::size_t DefaultCollisionsProgress::getPairsResolved() const
+{
+  return pairs_resolved_;
+}
+
+std::size_t DefaultCollisionsProgress::getPairsTotal() const
+{
+  return pairs_total_;
+}
+
+double DefaultCollisionsProgress::getElapsedTime() const
+{
+  return ros::WallTime::now().toSec() - start_time_;
+}
+
+double DefaultCollisionsProgress::getRemainingTime() const
+{
+  const unsigned int samples_total = samples_total_;
+  const unsigned int samples_done = getSamplesDone();
+  const unsigned int samples_checked = samples_checked_ - phase_samples_begin_;
+  if (samples_total == 0 || samples_checked == 0)
+    return -1.0;
+
+  // Assume the remaining samples of the phase take as long as the ones checked so far. Samples resumed from a
+  // checkpoint took no time in this run
+  double phase_elapsed = ros::WallTime::now().toSec() - phase_start_time_;
+  return phase_elapsed * (samples_total - std::min(samples_done, samples_total)) / samples_checked;
+}
+
+void DefaultCollisionsProgress::start(std::size_t pairs_total)
+{
+  phase_ = PHASE_SETUP;
+  percent_begin_ = 0;
+  percent_end_ = 0;
+  samples_total_ = 0;
+  samples_checked_ = 0;
+  phase_samples_begin_ = 0;
+  samples_resumed_ = 0;
+  pairs_resolved_ = 0;
+  pairs_total_ = pairs_total;
+  start_time_ = phase_start_time_ = ros::WallTime::now().toSec();
+  notify();
+}
+
+void DefaultCollisionsProgress::setPhase(DefaultCollisionsPhase phase, unsigned int percent_begin,
+                                         unsigned int percent_end, unsigned int samples_total)
+{
+  // The sample count goes first, so a reader does not see the new total with the old count
+  phase_samples_begin_ = samples_checked_.load();
+  samples_resumed_ = 0;
+  samples_total_ = samples_total;
+  percent_begin_ = percent_begin;
+  percent_end_ = percent_end;
+  phase_start_time_ = ros::WallTime::now().toSec();
+  phase_ = phase;
+  notify();
+}
+
+void DefaultCollisionsProgress::setSamplesTotal(unsigned int samples_total)
+{
+  samples_total_ = samples_total;
+}
+
+void DefaultCollisionsProgress::setPairsResolved(std::size_t pairs_resolved)
+{
+  pairs_resolved_ = pairs_resolved;
+}
+
+void DefaultCollisionsProgress::notify() const
+{
+  // The mutex only guards callback_. The copy is called unlocked, so a slow callback does not hold up other
+  // workers and a callback may replace itself with setCallback()
+  Callback callback;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    callback = callback_;
+  }
+  if (callback)
+    callback(*this);
+}
+
+// ******************************************************************************************
+// Converts a phase of computeDefaultCollisions() into a string
+// ******************************************************************************************
+const std::string defaultCollisionsPhaseToString( DefaultCollisionsPhase phase )
+{
+  return phasesToString.at( phase );
 }
 
 // ******************************************************************************************
@@ -0,0 +1,105 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/content_hash.h>
+#include <cstdio>
+#include <cstring>
+
+namespace moveit_setup_assistant
+{
+
+// FNV-1a parameters for 64 bit
+static const boost::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const boost::uint64_t FNV_PRIME = 1099511628211ULL;
+
+ContentHash::ContentHash()
+  : hash_(FNV_OFFSET_BASIS)
+{
+}
+
+ContentHash& ContentHash::add(const void *data, std::size_t size)
+{
+  const unsigned char *bytes = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0 ; i < size ; ++i)
+  {
+    hash_ ^= bytes[i];
+    hash_ *= FNV_PRIME;
+  }
+  return *this;
+}
+
+ContentHash& ContentHash::add(const std::string &value)
+{
+  add((boost::uint64_t)value.size());
+  return add(value.data(), value.size());
+}
+
+ContentHash& ContentHash::add(boost::uint64_t value)
+{
+  // Fixed byte order, independent of the platform
+  unsigned char bytes[8];
+  for (int i = 0 ; i < 8 ; ++i)
+    bytes[i] = (unsigned char)(value >> (8 * i));
+  return add(bytes, sizeof(bytes));
+}
+
+ContentHash& ContentHash::add(double value)
+{
+  if (value == 0.0)
+    value = 0.0; // normalize -0.0
+
+  boost::uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return add(bits);
+}
+
+std::string ContentHash::toString(boost::uint64_t hash)
+{
+  char buffer[17];
+  snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+  return buffer;
+}
+
+bool ContentHash::fromString(const std::string &text, boost::uint64_t &hash)
+{
+  unsigned long long value;
+  char rest;
+  if (text.size() != 16 || sscanf(text.c_str(), "%16llx%c", &value, &rest) != 1)
+    return false;
+
+  hash = value;
+  return true;
+}
+
+}
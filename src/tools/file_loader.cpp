@@ -35,12 +35,53 @@
 /* Author: Mathias Lüdtke */
 
 #include <moveit/setup_assistant/tools/file_loader.h>
+#include <moveit/setup_assistant/tools/content_hash.h>
 
+#include <ros/console.h>
+#include <ros/package.h>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <set>
+#include <sstream>
 #include <streambuf>
+#include <sys/wait.h>
+#include <unistd.h>
 
 namespace moveit_setup_assistant
 {
+// First line of a xacro cache entry, changed whenever the format changes
+static const char XACRO_CACHE_HEADER[] = "moveit_setup_assistant xacro cache 2";
+
+// Smallest free space for one read() of the xacro output
+static const std::size_t XACRO_READ_CHUNK = 64 * 1024;
+
+static boost::mutex xacro_cache_mutex; // guards the four members below
+static bool xacro_cache_directory_set = false;
+static std::string xacro_cache_directory;
+static bool xacro_version_set = false;
+static boost::uint64_t xacro_version;
+
+static FILE* startXacro(const std::string& args);
+static int readXacro(FILE* pipe, std::string& buffer);
+static bool splitXacroDeps(const std::string& deps, std::vector<std::string>& files);
+static boost::uint64_t getXacroVersion();
+static bool findEnvironmentVariables(const std::string& content, std::set<std::string>& names);
+static boost::uint64_t hashEnvironmentVariable(const std::string& name);
+static bool hashFile(const std::string& path, boost::uint64_t& hash);
+static std::string getXacroCachePath(const std::string& path, const std::vector<std::string>& xacro_args);
+static bool readXacroCache(std::string& buffer, const std::string& cache_path);
+static void writeXacroCache(const std::string& cache_path, const std::vector<std::string>& files,
+                            const char* data, std::size_t size);
+
 bool isXacroFile(const std::string& path)
 {
   // TODO: implement case-insensitive search
@@ -56,11 +97,14 @@ bool loadFileToString(std::string& buffer, const std::string& path)
   if (!stream.good())
     return false;
 
-  // Load the file to a string using an efficient memory allocation technique
+  // Load the file to a string with a single allocation and read
   stream.seekg(0, std::ios::end);
-  buffer.reserve(stream.tellg());
+  const std::streamoff size = stream.tellg();
   stream.seekg(0, std::ios::beg);
-  buffer.assign((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+  buffer.resize(size);
+  if (size > 0)
+    stream.read(&buffer[0], size);
+  buffer.resize(stream.gcount());
   stream.close();
 
   return true;
@@ -71,26 +115,310 @@ bool loadXacroFileToString(std::string& buffer, const std::string& path, const s
   if (path.empty())
     return false;
 
-  std::string cmd = "rosrun xacro xacro ";
+  // A hit skips the xacro process, which takes seconds to start
+  const std::string cache_path = getXacroCachePath(path, xacro_args);
+  if (!cache_path.empty() && readXacroCache(buffer, cache_path))
+    return true;
+
+  std::string args;
   for (std::vector<std::string>::const_iterator it = xacro_args.begin(); it != xacro_args.end(); ++it)
-    cmd += *it + " ";
-  cmd += path;
+    args += *it + " ";
+  args += path;
 
-  FILE* pipe = popen(cmd.c_str(), "r");
+  // The entry is only valid as long as none of the included files change. xacro cannot list them while
+  // expanding, so a second process runs alongside the first one and a miss costs no extra startup time
+  FILE* pipe = startXacro(args);
   if (!pipe)
+  {
+    ROS_ERROR_STREAM("Could not run xacro on '" << path << "'");
     return false;
+  }
+  FILE* deps_pipe = cache_path.empty() ? NULL : startXacro("--deps " + args);
+
+  // The output goes straight into the buffer, without a copy
+  const std::size_t offset = buffer.size();
+  const int status = readXacro(pipe, buffer);
+  std::string deps;
+  const int deps_status = deps_pipe ? readXacro(deps_pipe, deps) : -1;
+  if (status != 0)
+  {
+    ROS_ERROR_STREAM("xacro failed on '" << path << "' with exit code " << status);
+    buffer.resize(offset);
+    return false;
+  }
+  if (buffer.size() == offset || deps_status != 0)
+    return true;
 
-  char pipe_buffer[128];
-  while (!feof(pipe))
+  std::vector<std::string> files;
+  if (!splitXacroDeps(deps, files))
   {
-    if (fgets(pipe_buffer, 128, pipe) != NULL)
-      buffer += pipe_buffer;
+    ROS_DEBUG_STREAM("Could not parse the dependencies of '" << path << "', the result is not cached");
+    return true;
   }
-  pclose(pipe);
+  files.insert(files.begin(), path);
+  writeXacroCache(cache_path, files, buffer.data() + offset, buffer.size() - offset);
 
   return true;
 }
 
+std::string getXacroCacheDirectory()
+{
+  boost::mutex::scoped_lock lock(xacro_cache_mutex);
+  if (!xacro_cache_directory_set)
+  {
+    const char* ros_home = std::getenv("ROS_HOME");
+    const char* home = std::getenv("HOME");
+    if (ros_home)
+      xacro_cache_directory = (boost::filesystem::path(ros_home) / "xacro_cache").string();
+    else if (home)
+      xacro_cache_directory = (boost::filesystem::path(home) / ".ros" / "xacro_cache").string();
+    xacro_cache_directory_set = true;
+  }
+  return xacro_cache_directory;
+}
+
+void setXacroCacheDirectory(const std::string& path)
+{
+  boost::mutex::scoped_lock lock(xacro_cache_mutex);
+  xacro_cache_directory = path;
+  xacro_cache_directory_set = true;
+}
+
+static FILE* startXacro(const std::string& args)
+{
+  std::string cmd = "rosrun xacro xacro " + args;
+  return popen(cmd.c_str(), "r");
+}
+
+static int readXacro(FILE* pipe, std::string& buffer)
+{
+  // Expanded robots with inline meshes take several MB. Large reads go straight into the buffer, which grows
+  // geometrically, so the output is copied only when the buffer is grown
+  const int fd = fileno(pipe);
+  std::size_t size = buffer.size();
+  bool read_error = false;
+  while (true)
+  {
+    if (buffer.size() - size < XACRO_READ_CHUNK)
+      buffer.resize(std::max(2 * buffer.size(), size + XACRO_READ_CHUNK));
+    const ssize_t count = read(fd, &buffer[size], buffer.size() - size);
+    if (count > 0)
+      size += count;
+    else if (count == 0)
+      break;
+    else if (errno != EINTR)
+    {
+      read_error = true;
+      break;
+    }
+  }
+  buffer.resize(size);
+
+  const int status = pclose(pipe);
+  if (read_error || status == -1 || !WIFEXITED(status))
+    return -1;
+  return WEXITSTATUS(status);
+}
+
+static bool splitXacroDeps(const std::string& deps, std::vector<std::string>& files)
+{
+  // xacro joins the paths with single spaces, so a space may also be part of a path. Words are joined
+  // until they name an existing file; anything left over cannot be told apart and the split fails
+  std::vector<std::string> words;
+  const std::string trimmed = boost::algorithm::trim_copy_if(deps, boost::algorithm::is_any_of("\r\n"));
+  if (trimmed.empty())
+    return true;
+  boost::algorithm::split(words, trimmed, boost::algorithm::is_any_of(" "));
+
+  std::string file;
+  for (std::vector<std::string>::const_iterator it = words.begin(); it != words.end(); ++it)
+  {
+    file = file.empty() ? *it : file + " " + *it;
+    boost::system::error_code error;
+    if (!file.empty() && boost::filesystem::is_regular_file(file, error))
+    {
+      files.push_back(file);
+      file.clear();
+    }
+  }
+  return file.empty();
+}
+
+static boost::uint64_t getXacroVersion()
+{
+  // The manifest carries the version of the installed xacro; it is read once per process
+  boost::mutex::scoped_lock lock(xacro_cache_mutex);
+  if (!xacro_version_set)
+  {
+    xacro_version = 0;
+    const std::string package_path = ros::package::getPath("xacro");
+    std::string manifest;
+    if (!package_path.empty() &&
+        loadFileToString(manifest, (boost::filesystem::path(package_path) / "package.xml").string()))
+      xacro_version = ContentHash().add(manifest).value();
+    xacro_version_set = true;
+  }
+  return xacro_version;
+}
+
+static bool findEnvironmentVariables(const std::string& content, std::set<std::string>& names)
+{
+  static const char* const KEYWORDS[] = { "$(env ", "$(optenv " };
+  for (std::size_t k = 0; k < sizeof(KEYWORDS) / sizeof(KEYWORDS[0]); ++k)
+  {
+    const std::string keyword = KEYWORDS[k];
+    for (std::size_t pos = content.find(keyword); pos != std::string::npos; pos = content.find(keyword, pos))
+    {
+      pos = content.find_first_not_of(" \t", pos + keyword.size());
+      if (pos == std::string::npos)
+        return false;
+      const std::size_t end = content.find_first_of(" \t)", pos);
+      if (end == std::string::npos)
+        return false;
+
+      // Names built from other substitutions are only known to xacro
+      const std::string name = content.substr(pos, end - pos);
+      if (name.find('$') != std::string::npos)
+        return false;
+      names.insert(name);
+      pos = end;
+    }
+  }
+  return true;
+}
+
+static boost::uint64_t hashEnvironmentVariable(const std::string& name)
+{
+  // An unset variable differs from an empty one, $(optenv) falls back to its default only for the former
+  const char* value = std::getenv(name.c_str());
+  ContentHash hash;
+  hash.add((boost::uint64_t)(value ? 1 : 0));
+  hash.add(std::string(value ? value : ""));
+  return hash.value();
+}
+
+static bool hashFile(const std::string& path, boost::uint64_t& hash)
+{
+  std::string content;
+  if (!loadFileToString(content, path))
+    return false;
+  hash = ContentHash().add(content).value();
+  return true;
+}
+
+static std::string getXacroCachePath(const std::string& path, const std::vector<std::string>& xacro_args)
+{
+  const std::string directory = getXacroCacheDirectory();
+  if (directory.empty())
+    return std::string();
+
+  // $(find ...) in the files resolves against the package path, and other xacro versions expand differently.
+  // Variables read by $(env ...) and $(optenv ...) are stored in the entry, they are only known after a run
+  ContentHash hash;
+  hash.add(getXacroVersion());
+  hash.add(boost::filesystem::absolute(path).string());
+  hash.add((boost::uint64_t)xacro_args.size());
+  for (std::vector<std::string>::const_iterator it = xacro_args.begin(); it != xacro_args.end(); ++it)
+    hash.add(*it);
+  const char* package_path = std::getenv("ROS_PACKAGE_PATH");
+  hash.add(std::string(package_path ? package_path : ""));
+
+  return (boost::filesystem::path(directory) / (hash.toString() + ".xml")).string();
+}
+
+static bool readXacroCache(std::string& buffer, const std::string& cache_path)
+{
+  std::ifstream stream(cache_path.c_str());
+  if (!stream.good())
+    return false;
+
+  // Header, the number of files, one line per file with the hash of its content and its path, the number of
+  // environment variables, one line per variable with the hash of its value and its name, then the result
+  std::string line;
+  std::size_t file_count, variable_count;
+  if (!std::getline(stream, line) || line != XACRO_CACHE_HEADER || !(stream >> file_count))
+    return false;
+  std::getline(stream, line);
+  for (std::size_t i = 0; i < file_count; ++i)
+  {
+    boost::uint64_t stored_hash, hash;
+    if (!std::getline(stream, line) || line.size() < 18 ||
+        !ContentHash::fromString(line.substr(0, 16), stored_hash) ||
+        !hashFile(line.substr(17), hash) || hash != stored_hash)
+      return false;
+  }
+  if (!(stream >> variable_count))
+    return false;
+  std::getline(stream, line);
+  for (std::size_t i = 0; i < variable_count; ++i)
+  {
+    boost::uint64_t stored_hash;
+    if (!std::getline(stream, line) || line.size() < 18 ||
+        !ContentHash::fromString(line.substr(0, 16), stored_hash) ||
+        hashEnvironmentVariable(line.substr(17)) != stored_hash)
+      return false;
+  }
+
+  // The rest is the result, read at once
+  const std::streamoff begin = stream.tellg();
+  stream.seekg(0, std::ios::end);
+  const std::streamoff end = stream.tellg();
+  stream.seekg(begin, std::ios::beg);
+  const std::size_t offset = buffer.size();
+  buffer.resize(offset + (end - begin));
+  if (end > begin)
+    stream.read(&buffer[offset], end - begin);
+  buffer.resize(offset + stream.gcount());
+  return true;
+}
+
+static void writeXacroCache(const std::string& cache_path, const std::vector<std::string>& files,
+                            const char* data, std::size_t size)
+{
+  std::ostringstream entry;
+  std::set<std::string> variables;
+  entry << XACRO_CACHE_HEADER << "\n" << files.size() << "\n";
+  for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++it)
+  {
+    std::string content;
+    if (!loadFileToString(content, *it))
+      return;
+    if (!findEnvironmentVariables(content, variables))
+    {
+      ROS_DEBUG_STREAM("'" << *it << "' reads environment variables with computed names, the result is not cached");
+      return;
+    }
+    entry << ContentHash::toString(ContentHash().add(content).value()) << " "
+          << boost::filesystem::absolute(*it).string() << "\n";
+  }
+  entry << variables.size() << "\n";
+  for (std::set<std::string>::const_iterator it = variables.begin(); it != variables.end(); ++it)
+    entry << ContentHash::toString(hashEnvironmentVariable(*it)) << " " << *it << "\n";
+  entry.write(data, size);
+
+  // Written to a file of its own and renamed, so processes loading at the same time never read half an entry
+  boost::system::error_code error;
+  const boost::filesystem::path directory = boost::filesystem::path(cache_path).parent_path();
+  boost::filesystem::create_directories(directory, error);
+  std::ostringstream temp_name;
+  temp_name << cache_path << "." << getpid() << "." << boost::this_thread::get_id() << ".tmp";
+  const std::string temp_path = temp_name.str();
+  {
+    std::ofstream stream(temp_path.c_str(), std::ios_base::trunc);
+    stream << entry.str();
+    if (!stream.good())
+    {
+      ROS_DEBUG_STREAM("Could not write xacro cache entry " << temp_path);
+      stream.close();
+      boost::filesystem::remove(temp_path, error);
+      return;
+    }
+  }
+  boost::filesystem::rename(temp_path, cache_path, error);
+  if (error)
+    boost::filesystem::remove(temp_path, error);
+}
+
 bool loadXmlFileToString(std::string& buffer, const std::string& path, const std::vector<std::string>& xacro_args)
 {
   if (isXacroFile(path))
@@ -0,0 +1,241 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/incremental_result.h>
+#include <moveit/setup_assistant/tools/content_hash.h>
+#include <yaml-cpp/yaml.h>
+#include <ros/console.h>
+#include <cstdio>
+#include <fstream>
+
+namespace moveit_setup_assistant
+{
+
+// ******************************************************************************************
+// Static Prototypes
+// ******************************************************************************************
+
+/**
+ * \brief Add the verdict of a pair in a YAML node to a result
+ */
+static void readPair(const YAML::Node &node, IncrementalResult &result);
+
+// ******************************************************************************************
+// Read a result from a YAML file
+// ******************************************************************************************
+bool loadIncrementalResult(const std::string &file_path, IncrementalResult &result)
+{
+  result = IncrementalResult();
+
+  // Load file
+  std::ifstream input_stream(file_path.c_str());
+  if (!input_stream.good())
+  {
+    ROS_ERROR_STREAM("Unable to open file for reading " << file_path);
+    return false;
+  }
+
+  // Begin parsing
+  try
+  {
+    YAML::Node doc;
+#ifdef HAVE_NEW_YAMLCPP
+    doc = YAML::Load(input_stream);
+#else
+    YAML::Parser parser(input_stream);
+    parser.GetNextDocument(doc);
+#endif
+
+    // Files of older versions are a plain map of the links, without settings and verdicts
+    std::string settings;
+#ifdef HAVE_NEW_YAMLCPP
+    const YAML::Node links = doc["links"] ? doc["links"] : doc;
+    const YAML::Node pairs = doc["pairs"];
+    if (doc["settings"])
+      settings = doc["settings"].as<std::string>();
+#else
+    const YAML::Node *links_node = doc.FindValue("links");
+    const YAML::Node &links = links_node ? *links_node : doc;
+    const YAML::Node *pairs = doc.FindValue("pairs");
+    if (const YAML::Node *settings_node = doc.FindValue("settings"))
+      *settings_node >> settings;
+#endif
+    if (!settings.empty() && !ContentHash::fromString(settings, result.settings_hash))
+    {
+      ROS_ERROR_STREAM("Invalid settings hash in " << file_path);
+      result = IncrementalResult();
+      return false;
+    }
+
+    // Loop through all links
+#ifdef HAVE_NEW_YAMLCPP
+    for (YAML::const_iterator link_it = links.begin() ; link_it != links.end() ; ++link_it)
+#else
+    for (YAML::Iterator link_it = links.begin() ; link_it != links.end() ; ++link_it)
+#endif
+    {
+      std::string link_name, geometry, joint;
+#ifdef HAVE_NEW_YAMLCPP
+      link_name = link_it->first.as<std::string>();
+      geometry = link_it->second["geometry"].as<std::string>();
+      joint = link_it->second["joint"].as<std::string>();
+#else
+      link_it.first() >> link_name;
+      link_it.second()["geometry"] >> geometry;
+      link_it.second()["joint"] >> joint;
+#endif
+
+      LinkHash &hash = result.link_hashes[link_name];
+      if (!ContentHash::fromString(geometry, hash.geometry) || !ContentHash::fromString(joint, hash.joint))
+      {
+        ROS_ERROR_STREAM("Invalid hash of link " << link_name << " in " << file_path);
+        result = IncrementalResult();
+        return false;
+      }
+    }
+
+    // Loop through all pairs
+#ifdef HAVE_NEW_YAMLCPP
+    if (pairs)
+      for (YAML::const_iterator pair_it = pairs.begin() ; pair_it != pairs.end() ; ++pair_it)
+        readPair(*pair_it, result);
+#else
+    if (pairs)
+      for (YAML::Iterator pair_it = pairs->begin() ; pair_it != pairs->end() ; ++pair_it)
+        readPair(*pair_it, result);
+#endif
+  }
+  catch (YAML::Exception &e) // Catch errors
+  {
+    ROS_ERROR_STREAM("Error parsing " << file_path << ": " << e.what());
+    result = IncrementalResult();
+    return false;
+  }
+
+  return true; // file read successfully
+}
+
+// ******************************************************************************************
+// Write a result to a YAML file
+// ******************************************************************************************
+bool saveIncrementalResult(const std::string &file_path, const IncrementalResult &result)
+{
+  YAML::Emitter emitter;
+  emitter << YAML::BeginMap;
+  emitter << YAML::Key << "settings" << YAML::Value << ContentHash::toString(result.settings_hash);
+  emitter << YAML::Key << "links" << YAML::Value << YAML::BeginMap;
+  for (LinkHashMap::const_iterator it = result.link_hashes.begin() ; it != result.link_hashes.end() ; ++it)
+  {
+    emitter << YAML::Key << it->first;
+    emitter << YAML::Value << YAML::Flow << YAML::BeginMap;
+    emitter << YAML::Key << "geometry" << YAML::Value << ContentHash::toString(it->second.geometry);
+    emitter << YAML::Key << "joint" << YAML::Value << ContentHash::toString(it->second.joint);
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndMap;
+
+  // Every pair, the enabled ones included, so that an incremental run need not sample them again
+  emitter << YAML::Key << "pairs" << YAML::Value << YAML::BeginSeq;
+  for (LinkPairMap::const_iterator it = result.link_pairs.begin() ; it != result.link_pairs.end() ; ++it)
+  {
+    emitter << YAML::Flow << YAML::BeginMap;
+    emitter << YAML::Key << "link1" << YAML::Value << it->first.first;
+    emitter << YAML::Key << "link2" << YAML::Value << it->first.second;
+    emitter << YAML::Key << "reason" << YAML::Value << disabledReasonToString(it->second.reason);
+    emitter << YAML::Key << "disabled" << YAML::Value << it->second.disable_check;
+    emitter << YAML::Key << "frequency" << YAML::Value << it->second.collision_frequency;
+    emitter << YAML::Key << "distance" << YAML::Value << it->second.min_distance;
+    emitter << YAML::EndMap;
+  }
+  emitter << YAML::EndSeq;
+  emitter << YAML::EndMap;
+
+  // Write next to the target and rename, so that a failed write never leaves a truncated file that a later
+  // incremental run would trust
+  const std::string temp_path = file_path + ".tmp";
+  std::ofstream output_stream(temp_path.c_str(), std::ios_base::trunc);
+  if (!output_stream.good())
+  {
+    ROS_ERROR_STREAM("Unable to open file for writing " << temp_path);
+    return false;
+  }
+
+  output_stream << emitter.c_str();
+  output_stream.close();
+  if (output_stream.fail())
+  {
+    ROS_ERROR_STREAM("Unable to write incremental result to " << temp_path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+
+  if (std::rename(temp_path.c_str(), file_path.c_str()) != 0)
+  {
+    ROS_ERROR_STREAM("Unable to replace incremental result " << file_path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+
+  return true; // file created successfully
+}
+
+// ******************************************************************************************
+// Add the verdict of a pair in a YAML node to a result
+// ******************************************************************************************
+void readPair(const YAML::Node &node, IncrementalResult &result)
+{
+  std::string link1, link2, reason;
+  LinkPairData data;
+#ifdef HAVE_NEW_YAMLCPP
+  link1 = node["link1"].as<std::string>();
+  link2 = node["link2"].as<std::string>();
+  reason = node["reason"].as<std::string>();
+  data.disable_check = node["disabled"].as<bool>();
+  data.collision_frequency = node["frequency"].as<double>();
+  data.min_distance = node["distance"].as<double>();
+#else
+  node["link1"] >> link1;
+  node["link2"] >> link2;
+  node["reason"] >> reason;
+  node["disabled"] >> data.disable_check;
+  node["frequency"] >> data.collision_frequency;
+  node["distance"] >> data.min_distance;
+#endif
+  data.reason = disabledReasonFromString(reason);
+
+  // LinkPairMap keys are ordered alphabetically
+  result.link_pairs[std::make_pair(std::min(link1, link2), std::max(link1, link2))] = data;
+}
+
+}
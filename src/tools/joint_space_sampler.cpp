@@ -0,0 +1,334 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/joint_space_sampler.h>
+#include <boost/assign.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/cstdint.hpp>
+#include <cmath>
+
+namespace moveit_setup_assistant
+{
+
+// ******************************************************************************************
+// Static Prototypes
+// ******************************************************************************************
+
+/**
+ * \brief Combine a seed and an index into a well-distributed seed for a random number generator
+ */
+static boost::uint32_t mixSeed(boost::uint32_t seed, boost::uint32_t index);
+
+/**
+ * \brief Set the given joints to uniform random positions using a random number generator
+ */
+static void sampleJointsAtRandom(const std::vector<const robot_model::JointModel*> &joints,
+                                 random_numbers::RandomNumberGenerator &rng, robot_state::RobotState &state);
+
+/**
+ * \brief Move the given joints to random positions near their current positions using a random number generator
+ * \param radius Largest change of a joint, as a fraction of its maximum extent
+ */
+static void sampleJointsNearBy(const std::vector<const robot_model::JointModel*> &joints, double radius,
+                               random_numbers::RandomNumberGenerator &rng, robot_state::RobotState &state);
+
+// Boost mapping of sampler types to strings
+const boost::unordered_map<std::string, SamplerType> samplerTypesFromString = boost::assign::map_list_of
+  ( "random", UNIFORM_RANDOM )
+  ( "halton", SCRAMBLED_HALTON );
+
+// ******************************************************************************************
+// Generates robot states from an indexed sequence
+// ******************************************************************************************
+JointSpaceSampler::JointSpaceSampler(const robot_model::RobotModelConstPtr &robot_model, int seed)
+  : robot_model_(robot_model), seed_(seed)
+{
+}
+
+JointSpaceSampler::~JointSpaceSampler()
+{
+}
+
+void JointSpaceSampler::sampleAtRandom(const std::vector<const robot_model::JointModel*> &joints, unsigned int index,
+                                       robot_state::RobotState &state) const
+{
+  if (joints.empty())
+    return;
+
+  if (seed_ < 0)
+  {
+    sampleJointsAtRandom(joints, state.getRandomNumberGenerator(), state);
+  }
+  else
+  {
+    // Generator for this index only, so the result does not depend on previously drawn samples
+    random_numbers::RandomNumberGenerator rng(mixSeed(seed_, index));
+    sampleJointsAtRandom(joints, rng, state);
+  }
+}
+
+// ******************************************************************************************
+// Uniform pseudo-random samples
+// ******************************************************************************************
+UniformRandomSampler::UniformRandomSampler(const robot_model::RobotModelConstPtr &robot_model, int seed)
+  : JointSpaceSampler(robot_model, seed)
+{
+}
+
+void UniformRandomSampler::sample(unsigned int index, robot_state::RobotState &state) const
+{
+  if (seed_ < 0)
+    state.setToRandomPositions();
+  else
+    sampleAtRandom(robot_model_->getActiveJointModels(), index, state);
+}
+
+// ******************************************************************************************
+// Scrambled Halton sequence
+// ******************************************************************************************
+ScrambledHaltonSampler::ScrambledHaltonSampler(const robot_model::RobotModelConstPtr &robot_model, int seed)
+  : JointSpaceSampler(robot_model, seed)
+{
+  // The scrambling is the only random part of the sequence itself
+  boost::scoped_ptr<random_numbers::RandomNumberGenerator> rng(
+    seed < 0 ? new random_numbers::RandomNumberGenerator() : new random_numbers::RandomNumberGenerator(seed));
+
+  unsigned int candidate = 1; // last number checked for being prime
+  const std::vector<const robot_model::JointModel*> &joints = robot_model->getActiveJointModels();
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+  {
+    // Only joints with a single bounded variable are part of the sequence
+    if (joints[i]->getType() != robot_model::JointModel::REVOLUTE &&
+        joints[i]->getType() != robot_model::JointModel::PRISMATIC)
+    {
+      random_joints_.push_back(joints[i]);
+      continue;
+    }
+
+    Dimension dimension;
+    dimension.joint_ = joints[i];
+    dimension.min_ = joints[i]->getVariableBounds()[0].min_position_;
+    dimension.range_ = joints[i]->getVariableBounds()[0].max_position_ - dimension.min_;
+    dimension.shift_ = rng->uniform01();
+
+    // Next prime as base
+    bool prime = false;
+    while (!prime)
+    {
+      ++candidate;
+      prime = true;
+      for (unsigned int d = 2 ; d * d <= candidate && prime ; ++d)
+        prime = candidate % d != 0;
+    }
+    dimension.base_ = candidate;
+
+    randomDigitPermutation(dimension.base_, *rng, dimension.permutation_);
+
+    dimensions_.push_back(dimension);
+  }
+}
+
+void ScrambledHaltonSampler::sample(unsigned int index, robot_state::RobotState &state) const
+{
+  for (std::size_t i = 0 ; i < dimensions_.size() ; ++i)
+  {
+    double u = scrambledRadicalInverse(index, dimensions_[i].base_, dimensions_[i].permutation_) +
+               dimensions_[i].shift_;
+    if (u >= 1.0)
+      u -= 1.0;
+
+    double position = dimensions_[i].min_ + u * dimensions_[i].range_;
+    state.setJointPositions(dimensions_[i].joint_, &position);
+  }
+
+  // The remaining joints do not fit into the unit cube of the sequence
+  sampleAtRandom(random_joints_, index, state);
+}
+
+// ******************************************************************************************
+// Scrambled radical inverse of an index
+// ******************************************************************************************
+double scrambledRadicalInverse(unsigned int index, unsigned int base, const std::vector<unsigned int> &permutation)
+{
+  const double inv_base = 1.0 / base;
+  double factor = inv_base;
+  double result = 0.0;
+
+  // Mirror the digits of index at the decimal point
+  while (index > 0)
+  {
+    result += permutation[index % base] * factor;
+    index /= base;
+    factor *= inv_base;
+  }
+
+  return result;
+}
+
+// ******************************************************************************************
+// Random permutation of the digits of a base
+// ******************************************************************************************
+void randomDigitPermutation(unsigned int base, random_numbers::RandomNumberGenerator &rng,
+                            std::vector<unsigned int> &permutation)
+{
+  // Zero stays in place so that the expansion stays finite
+  permutation.resize(base);
+  for (unsigned int d = 0 ; d < base ; ++d)
+    permutation[d] = d;
+  for (unsigned int d = base - 1 ; d > 1 ; --d)
+    std::swap(permutation[d], permutation[rng.uniformInteger(1, d)]);
+}
+
+// ******************************************************************************************
+// Samples around given robot states
+// ******************************************************************************************
+FocusedSampler::FocusedSampler(const robot_model::RobotModelConstPtr &robot_model, double radius, int seed)
+  : JointSpaceSampler(robot_model, seed), radius_(radius)
+{
+}
+
+void FocusedSampler::setTargets(const std::vector<Target> &targets)
+{
+  targets_ = targets;
+}
+
+void FocusedSampler::sample(unsigned int index, robot_state::RobotState &state) const
+{
+  const Target &target = targets_[index % targets_.size()];
+  state.setVariablePositions(target.positions_);
+
+  if (seed_ < 0)
+  {
+    sampleJointsNearBy(target.joints_, radius_, state.getRandomNumberGenerator(), state);
+  }
+  else
+  {
+    // Generator for this index only, so the result does not depend on previously drawn samples
+    random_numbers::RandomNumberGenerator rng(mixSeed(seed_, index));
+    sampleJointsNearBy(target.joints_, radius_, rng, state);
+  }
+}
+
+// ******************************************************************************************
+// Create a sampler of the given type for a robot model
+// ******************************************************************************************
+JointSpaceSamplerPtr createJointSpaceSampler(SamplerType type, const robot_model::RobotModelConstPtr &robot_model,
+                                             int seed)
+{
+  switch (type)
+  {
+    case SCRAMBLED_HALTON:
+      return JointSpaceSamplerPtr(new ScrambledHaltonSampler(robot_model, seed));
+    case UNIFORM_RANDOM:
+    default:
+      return JointSpaceSamplerPtr(new UniformRandomSampler(robot_model, seed));
+  }
+}
+
+// ******************************************************************************************
+// Combine a seed and an index into a well-distributed seed for a random number generator
+// ******************************************************************************************
+boost::uint32_t mixSeed(boost::uint32_t seed, boost::uint32_t index)
+{
+  // Finalizer of MurmurHash3 on both words, so that neighbouring indices give unrelated generators
+  boost::uint64_t h = ((boost::uint64_t)seed << 32) | index;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return (boost::uint32_t)h;
+}
+
+// ******************************************************************************************
+// Set the given joints to uniform random positions using a random number generator
+// ******************************************************************************************
+void sampleJointsAtRandom(const std::vector<const robot_model::JointModel*> &joints,
+                          random_numbers::RandomNumberGenerator &rng, robot_state::RobotState &state)
+{
+  std::vector<double> positions;
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+  {
+    positions.resize(joints[i]->getVariableCount());
+    joints[i]->getVariableRandomPositions(rng, &positions[0]);
+    state.setJointPositions(joints[i], &positions[0]);
+  }
+}
+
+// ******************************************************************************************
+// Move the given joints to random positions near their current positions
+// ******************************************************************************************
+void sampleJointsNearBy(const std::vector<const robot_model::JointModel*> &joints, double radius,
+                        random_numbers::RandomNumberGenerator &rng, robot_state::RobotState &state)
+{
+  std::vector<double> near, positions;
+  for (std::size_t i = 0 ; i < joints.size() ; ++i)
+  {
+    const double *current = state.getJointPositions(joints[i]);
+    near.assign(current, current + joints[i]->getVariableCount());
+    positions.resize(joints[i]->getVariableCount());
+    joints[i]->getVariableRandomPositionsNearBy(rng, &positions[0], &near[0], radius * joints[i]->getMaximumExtent());
+    state.setJointPositions(joints[i], &positions[0]);
+  }
+}
+
+// ******************************************************************************************
+// Converts a sampler type into a string
+// ******************************************************************************************
+std::string samplerTypeToString(SamplerType type)
+{
+  for (boost::unordered_map<std::string, SamplerType>::const_iterator it = samplerTypesFromString.begin() ;
+       it != samplerTypesFromString.end() ; ++it)
+  {
+    if (it->second == type)
+      return it->first;
+  }
+  return "";
+}
+
+// ******************************************************************************************
+// Converts a string into a sampler type
+// ******************************************************************************************
+bool samplerTypeFromString(const std::string &name, SamplerType &type)
+{
+  boost::unordered_map<std::string, SamplerType>::const_iterator it = samplerTypesFromString.find(name);
+  if (it == samplerTypesFromString.end())
+    return false;
+
+  type = it->second;
+  return true;
+}
+
+}
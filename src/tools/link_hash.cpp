@@ -0,0 +1,184 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/link_hash.h>
+#include <moveit/setup_assistant/tools/content_hash.h>
+#include <geometric_shapes/shapes.h>
+
+namespace moveit_setup_assistant
+{
+
+// ******************************************************************************************
+// Static Prototypes
+// ******************************************************************************************
+
+/**
+ * \brief Add the dimensions, or vertices and triangles, of a shape to a hash
+ */
+static void hashShape(const shapes::Shape *shape, ContentHash &hash);
+
+/**
+ * \brief Add an affine transform to a hash
+ */
+static void hashTransform(const Eigen::Affine3d &transform, ContentHash &hash);
+
+// ******************************************************************************************
+// Hash the geometry and parent joint of every link of a robot
+// ******************************************************************************************
+void computeLinkHashes(const planning_scene::PlanningScene &scene, LinkHashMap &hashes)
+{
+  hashes.clear();
+
+  const std::vector<const robot_model::LinkModel*> &links = scene.getRobotModel()->getLinkModels();
+  for (std::size_t i = 0 ; i < links.size() ; ++i)
+  {
+    const robot_model::LinkModel *link = links[i];
+
+    // Geometry
+    ContentHash geometry;
+    geometry.add((boost::uint64_t)link->getShapes().size());
+    for (std::size_t j = 0 ; j < link->getShapes().size() ; ++j)
+    {
+      hashShape(link->getShapes()[j].get(), geometry);
+      hashTransform(link->getCollisionOriginTransforms()[j], geometry);
+    }
+    geometry.add(scene.getCollisionRobot()->getLinkPadding(link->getName()));
+    geometry.add(scene.getCollisionRobot()->getLinkScale(link->getName()));
+
+    // Parent joint
+    ContentHash joint;
+    const robot_model::JointModel *joint_model = link->getParentJointModel();
+    joint.add(link->getParentLinkModel() ? link->getParentLinkModel()->getName() : std::string());
+    if (joint_model)
+    {
+      joint.add(joint_model->getName());
+      joint.add((boost::uint64_t)joint_model->getType());
+      hashTransform(link->getJointOriginTransform(), joint);
+
+      const robot_model::JointModel::Bounds &bounds = joint_model->getVariableBounds();
+      for (std::size_t j = 0 ; j < bounds.size() ; ++j)
+      {
+        joint.add((boost::uint64_t)bounds[j].position_bounded_);
+        joint.add(bounds[j].min_position_);
+        joint.add(bounds[j].max_position_);
+      }
+
+      const Eigen::Vector3d *axis = NULL;
+      if (joint_model->getType() == robot_model::JointModel::REVOLUTE)
+        axis = &static_cast<const robot_model::RevoluteJointModel*>(joint_model)->getAxis();
+      else if (joint_model->getType() == robot_model::JointModel::PRISMATIC)
+        axis = &static_cast<const robot_model::PrismaticJointModel*>(joint_model)->getAxis();
+      if (axis)
+      {
+        joint.add(axis->x());
+        joint.add(axis->y());
+        joint.add(axis->z());
+      }
+
+      if (joint_model->getMimic())
+      {
+        joint.add(joint_model->getMimic()->getName());
+        joint.add(joint_model->getMimicFactor());
+        joint.add(joint_model->getMimicOffset());
+      }
+    }
+
+    LinkHash &hash = hashes[link->getName()];
+    hash.geometry = geometry.value();
+    hash.joint = joint.value();
+  }
+}
+
+// ******************************************************************************************
+// Add the dimensions, or vertices and triangles, of a shape to a hash
+// ******************************************************************************************
+void hashShape(const shapes::Shape *shape, ContentHash &hash)
+{
+  hash.add((boost::uint64_t)shape->type);
+  switch (shape->type)
+  {
+    case shapes::SPHERE:
+      hash.add(static_cast<const shapes::Sphere*>(shape)->radius);
+      break;
+    case shapes::BOX:
+    {
+      const double *size = static_cast<const shapes::Box*>(shape)->size;
+      hash.add(size[0]).add(size[1]).add(size[2]);
+      break;
+    }
+    case shapes::CYLINDER:
+      hash.add(static_cast<const shapes::Cylinder*>(shape)->radius);
+      hash.add(static_cast<const shapes::Cylinder*>(shape)->length);
+      break;
+    case shapes::CONE:
+      hash.add(static_cast<const shapes::Cone*>(shape)->radius);
+      hash.add(static_cast<const shapes::Cone*>(shape)->length);
+      break;
+    case shapes::MESH:
+    {
+      const shapes::Mesh *mesh = static_cast<const shapes::Mesh*>(shape);
+      hash.add((boost::uint64_t)mesh->vertex_count);
+      for (unsigned int i = 0 ; i < 3 * mesh->vertex_count ; ++i)
+        hash.add(mesh->vertices[i]);
+      hash.add((boost::uint64_t)mesh->triangle_count);
+      for (unsigned int i = 0 ; i < 3 * mesh->triangle_count ; ++i)
+        hash.add((boost::uint64_t)mesh->triangles[i]);
+      break;
+    }
+    default:
+      break; // planes and octrees are not used as link geometry
+  }
+}
+
+// ******************************************************************************************
+// Add an affine transform to a hash
+// ******************************************************************************************
+void hashTransform(const Eigen::Affine3d &transform, ContentHash &hash)
+{
+  for (int row = 0 ; row < 3 ; ++row)
+    for (int col = 0 ; col < 4 ; ++col)
+      hash.add(transform.matrix()(row, col));
+}
+
+// ******************************************************************************************
+// Hashes of a link, zero hashes if the link is not in the map
+// ******************************************************************************************
+const LinkHash& findLinkHash(const LinkHashMap &hashes, const std::string &link_name)
+{
+  static const LinkHash missing;
+  LinkHashMap::const_iterator it = hashes.find(link_name);
+  return it != hashes.end() ? it->second : missing;
+}
+
+}
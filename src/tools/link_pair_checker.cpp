@@ -0,0 +1,175 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/link_pair_checker.h>
+#include <moveit/collision_detection_fcl/collision_common.h>
+#include <fcl/collision.h>
+#include <fcl/distance.h>
+#include <fcl/collision_object.h>
+#include <ros/console.h>
+#include <algorithm>
+#include <limits>
+
+namespace moveit_setup_assistant
+{
+
+// ******************************************************************************************
+// Checks single pairs of links for collision in a batch of states
+// ******************************************************************************************
+LinkPairChecker::LinkPairChecker(const planning_scene::PlanningScene &scene,
+                                 const std::vector<std::string> &link_names)
+  : links_(link_names.size()), states_(NULL), state_count_(0), batch_count_(0)
+{
+  const collision_detection::CollisionRobotConstPtr &collision_robot = scene.getCollisionRobot();
+  for (std::size_t i = 0 ; i < link_names.size() ; ++i)
+  {
+    LinkObjects &link = links_[i];
+    link.link_ = scene.getRobotModel()->getLinkModel(link_names[i]);
+    link.batch_count_ = 0;
+
+    // The geometry is cached by MoveIt, so all threads share it and only the objects are per checker
+    const double padding = collision_robot->getLinkPadding(link_names[i]);
+    const double scale = collision_robot->getLinkScale(link_names[i]);
+    for (std::size_t j = 0 ; j < link.link_->getShapes().size() ; ++j)
+    {
+      collision_detection::FCLGeometryConstPtr geometry =
+        collision_detection::createCollisionGeometry(link.link_->getShapes()[j], scale, padding, link.link_, j);
+      if (!geometry)
+      {
+        ROS_WARN_STREAM("Shape " << j << " of link " << link_names[i] << " is not supported by FCL and ignored");
+        continue;
+      }
+      link.objects_.push_back(boost::shared_ptr<fcl::CollisionObject>(
+        new fcl::CollisionObject(geometry->collision_geometry_, fcl::Transform3f())));
+      link.shape_indices_.push_back(j);
+    }
+  }
+}
+
+void LinkPairChecker::setStates(const std::vector<robot_state::RobotState> &states, std::size_t count)
+{
+  states_ = &states;
+  state_count_ = count;
+  ++batch_count_; // all links are out of date now
+}
+
+bool LinkPairChecker::checkPair(int link_a, int link_b, std::size_t state)
+{
+  LinkObjects &a = links_[link_a];
+  LinkObjects &b = links_[link_b];
+  updateLink(a);
+  updateLink(b);
+
+  // Shapes whose bounding boxes are apart cannot collide, only the others go through the narrowphase
+  fcl::CollisionRequest request(1, false);
+  for (std::size_t i = 0 ; i < a.objects_.size() ; ++i)
+  {
+    const std::size_t slot_a = i * state_count_ + state;
+    for (std::size_t j = 0 ; j < b.objects_.size() ; ++j)
+    {
+      const std::size_t slot_b = j * state_count_ + state;
+      if (!a.aabbs_[slot_a].overlap(b.aabbs_[slot_b]))
+        continue;
+
+      a.objects_[i]->setTransform(a.transforms_[slot_a]);
+      b.objects_[j]->setTransform(b.transforms_[slot_b]);
+      fcl::CollisionResult result;
+      if (fcl::collide(a.objects_[i].get(), b.objects_[j].get(), request, result) > 0)
+        return true;
+    }
+  }
+
+  return false;
+}
+
+double LinkPairChecker::distancePair(int link_a, int link_b, const robot_state::RobotState &state)
+{
+  LinkObjects &a = links_[link_a];
+  LinkObjects &b = links_[link_b];
+  placeLink(a, state);
+  placeLink(b, state);
+
+  // Smallest distance over all pairs of shapes, touching shapes end the search
+  double distance = std::numeric_limits<double>::infinity();
+  fcl::DistanceRequest request;
+  for (std::size_t i = 0 ; i < a.objects_.size() ; ++i)
+  {
+    for (std::size_t j = 0 ; j < b.objects_.size() ; ++j)
+    {
+      fcl::DistanceResult result;
+      fcl::distance(a.objects_[i].get(), b.objects_[j].get(), request, result);
+      distance = std::min<double>(distance, result.min_distance);
+      if (distance <= 0.0)
+        return 0.0;
+    }
+  }
+
+  return distance;
+}
+
+void LinkPairChecker::placeLink(LinkObjects &link, const robot_state::RobotState &state)
+{
+  fcl::Transform3f transform;
+  for (std::size_t i = 0 ; i < link.objects_.size() ; ++i)
+  {
+    collision_detection::transform2fcl(state.getCollisionBodyTransform(link.link_, link.shape_indices_[i]), transform);
+    link.objects_[i]->setTransform(transform);
+  }
+}
+
+void LinkPairChecker::updateLink(LinkObjects &link)
+{
+  if (link.batch_count_ == batch_count_)
+    return;
+
+  // Reuse the buffers of the previous batches
+  link.transforms_.resize(link.objects_.size() * state_count_);
+  link.aabbs_.resize(link.objects_.size() * state_count_);
+  for (std::size_t i = 0 ; i < link.objects_.size() ; ++i)
+  {
+    for (std::size_t state = 0 ; state < state_count_ ; ++state)
+    {
+      const std::size_t slot = i * state_count_ + state;
+      const robot_state::RobotState &sampled_state = (*states_)[state];
+      collision_detection::transform2fcl(sampled_state.getCollisionBodyTransform(link.link_, link.shape_indices_[i]),
+                                         link.transforms_[slot]);
+      link.objects_[i]->setTransform(link.transforms_[slot]);
+      link.objects_[i]->computeAABB();
+      link.aabbs_[slot] = link.objects_[i]->getAABB();
+    }
+  }
+  link.batch_count_ = batch_count_;
+}
+
+}
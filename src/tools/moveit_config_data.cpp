@@ -143,6 +143,15 @@ void loadYaml(std::istream& in_stream, YAML::Node& doc_out)
 #endif
 }
 
+// Path of the MoveIt Setup Assistant package with the templates. Looking up a package is slow, so it is done once
+// per process and shared by all config data objects
+static const std::string& getSetupAssistantPackagePath()
+{
+  static const std::string path = ros::package::getPath("moveit_setup_assistant");
+  static const std::string current_directory = ".";
+  return path.empty() ? current_directory : path;
+}
+
 // ******************************************************************************************
 // Constructor
 // ******************************************************************************************
@@ -157,11 +166,7 @@ MoveItConfigData::MoveItConfigData() :
   debug_ = false;
 
   // Get MoveIt Setup Assistant package path
-  setup_assistant_path_ = ros::package::getPath("moveit_setup_assistant");
-  if( setup_assistant_path_.empty() )
-  {
-    setup_assistant_path_ = ".";
-  }
+  setup_assistant_path_ = getSetupAssistantPackagePath();
 }
 
 // ******************************************************************************************
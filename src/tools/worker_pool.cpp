@@ -0,0 +1,185 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/worker_pool.h>
+#include <boost/bind.hpp>
+
+namespace moveit_setup_assistant
+{
+
+// ******************************************************************************************
+// Tasks that are submitted to the pool together and waited for together
+// ******************************************************************************************
+WorkerPool::TaskGroup::TaskGroup(WorkerPool &pool) : pool_(pool), pending_(0)
+{
+}
+
+WorkerPool::TaskGroup::~TaskGroup()
+{
+  boost::unique_lock<boost::mutex> lock(pool_.mutex_);
+  waitDone(lock);
+}
+
+void WorkerPool::TaskGroup::submit(const boost::function<void ()> &task)
+{
+  {
+    boost::unique_lock<boost::mutex> lock(pool_.mutex_);
+    Task queued;
+    queued.function_ = task;
+    queued.group_ = this;
+    pool_.queue_.push_back(queued);
+    ++pending_;
+  }
+  pool_.work_available_.notify_one();
+}
+
+void WorkerPool::TaskGroup::wait()
+{
+  boost::unique_lock<boost::mutex> lock(pool_.mutex_);
+  waitDone(lock);
+  rethrowError(lock);
+}
+
+bool WorkerPool::TaskGroup::timedWait(const boost::posix_time::time_duration &timeout)
+{
+  const boost::system_time deadline = boost::get_system_time() + timeout;
+  boost::unique_lock<boost::mutex> lock(pool_.mutex_);
+  while (pending_ > 0)
+  {
+    if (!pool_.task_done_.timed_wait(lock, deadline) && pending_ > 0)
+      return false;
+  }
+  rethrowError(lock);
+  return true;
+}
+
+void WorkerPool::TaskGroup::waitDone(boost::unique_lock<boost::mutex> &lock)
+{
+  while (pending_ > 0)
+  {
+    // Help with our own tasks instead of blocking one of the threads they may be waiting for. A task of another group,
+    // like a whole package of a batch, could keep this thread away from our tasks for far longer than they take
+    std::deque<Task>::iterator task_it = pool_.queue_.begin();
+    while (task_it != pool_.queue_.end() && task_it->group_ != this)
+      ++task_it;
+    if (task_it != pool_.queue_.end())
+      pool_.runTask(lock, task_it);
+    else
+      pool_.task_done_.wait(lock);
+  }
+}
+
+void WorkerPool::TaskGroup::rethrowError(boost::unique_lock<boost::mutex> &lock)
+{
+  boost::exception_ptr error = error_;
+  error_ = boost::exception_ptr();
+  lock.unlock();
+  if (error)
+    boost::rethrow_exception(error);
+}
+
+// ******************************************************************************************
+// Process-wide pool of worker threads
+// ******************************************************************************************
+WorkerPool& WorkerPool::getInstance()
+{
+  static WorkerPool pool;
+  return pool;
+}
+
+WorkerPool::WorkerPool() : thread_count_(0), stopping_(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  threads_.join_all();
+}
+
+void WorkerPool::reserve(unsigned int threads)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for ( ; thread_count_ < threads ; ++thread_count_)
+    threads_.create_thread(boost::bind(&WorkerPool::workerLoop, this));
+}
+
+unsigned int WorkerPool::getThreadCount() const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  return thread_count_;
+}
+
+void WorkerPool::workerLoop()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (true)
+  {
+    while (queue_.empty() && !stopping_)
+      work_available_.wait(lock);
+    if (stopping_)
+      return;
+    runTask(lock, queue_.begin());
+  }
+}
+
+void WorkerPool::runTask(boost::unique_lock<boost::mutex> &lock, std::deque<Task>::iterator task_it)
+{
+  Task task = *task_it;
+  queue_.erase(task_it);
+
+  // The task counts as done even if it throws, otherwise its group would wait forever
+  boost::exception_ptr error;
+  lock.unlock();
+  try
+  {
+    task.function_();
+  }
+  catch (...)
+  {
+    error = boost::current_exception();
+  }
+  lock.lock();
+
+  if (error && !task.group_->error_)
+    task.group_->error_ = error;
+  --task.group_->pending_;
+  task_done_.notify_all();
+}
+
+}
@@ -41,9 +41,12 @@
 #include <QFont>
 #include <QApplication>
 #include "default_collisions_widget.h"
+#include <moveit/setup_assistant/tools/worker_pool.h>
 #include <boost/unordered_map.hpp>
 #include <boost/assign.hpp>
 #include <ros/console.h>
+#include <cmath>
+#include <limits>
 
 namespace moveit_setup_assistant
 {
@@ -56,7 +59,9 @@ const boost::unordered_map<moveit_setup_assistant::DisabledReason, const char*>
   ( moveit_setup_assistant::ADJACENT, "Adjacent Links" )
   ( moveit_setup_assistant::ALWAYS, "Always in Collision" )
   ( moveit_setup_assistant::USER, "User Disabled" )
-  ( moveit_setup_assistant::NOT_DISABLED, "");
+  ( moveit_setup_assistant::NOT_DISABLED, "")
+  ( moveit_setup_assistant::UNREACHABLE, "Out of Reach" )
+  ( moveit_setup_assistant::RARELY, "Rarely in Collision" );
 
 /**
  * \brief Subclass QTableWidgetItem for checkboxes to allow custom sorting by implementing the < operator
@@ -72,12 +77,39 @@ public:
   }
 };
 
+/**
+ * \brief Subclass QTableWidgetItem for collision frequencies to sort by the number instead of the displayed text
+ */
+class FrequencySortWidgetItem : public QTableWidgetItem {
+public:
+  /**
+   * \param frequency Fraction of trials in collision, negative if unknown
+   */
+  explicit FrequencySortWidgetItem( double frequency )
+    : QTableWidgetItem( frequency < 0.0 ? QString() : QString("p=%1%").arg(100.0 * frequency, 0, 'g', 3) ),
+      frequency_( frequency )
+  {
+  }
+
+  /**
+   * \brief Override the standard comparision operator
+   */
+  bool operator <(const QTableWidgetItem &other) const
+  {
+    const FrequencySortWidgetItem *item = dynamic_cast<const FrequencySortWidgetItem*>(&other);
+    return item ? frequency_ < item->frequency_ : QTableWidgetItem::operator<(other);
+  }
+
+private:
+  double frequency_;
+};
+
 // ******************************************************************************************
 // User interface for editing the default collision matrix list in an SRDF
 // ******************************************************************************************
 DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
                                                   MoveItConfigDataPtr config_data )
-  : SetupScreenWidget( parent ), config_data_(config_data)
+  : SetupScreenWidget( parent ), config_data_(config_data), collision_progress_(NULL)
 {
   // Basic widget container
   layout_ = new QVBoxLayout( this );
@@ -123,6 +155,20 @@ DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
   controls_box_layout->addWidget(density_value_label_);
   changeDensityLabel( density_slider_->value() ); // initialize label with value
 
+  // Time Budget, replaces the sampling density when checked
+  budget_checkbox_ = new QCheckBox( this );
+  budget_checkbox_->setText("Time Budget:");
+  budget_checkbox_->setToolTip("Sample until the time is up instead of a fixed number of samples");
+  controls_box_layout->addWidget(budget_checkbox_);
+
+  budget_spinbox_ = new QSpinBox( this );
+  budget_spinbox_->setRange(1, 3600);
+  budget_spinbox_->setValue(30);
+  budget_spinbox_->setSuffix(" s");
+  budget_spinbox_->setEnabled(false);
+  controls_box_layout->addWidget(budget_spinbox_);
+  connect(budget_checkbox_, SIGNAL(toggled(bool)), budget_spinbox_, SLOT(setEnabled(bool)));
+  connect(budget_checkbox_, SIGNAL(toggled(bool)), density_slider_, SLOT(setDisabled(bool)));
 
   // Generate Button
   btn_generate_ = new QPushButton( this );
@@ -147,11 +193,20 @@ DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
   progress_bar_->hide(); // only show when computation begins
   layout_->addWidget(progress_bar_); //,Qt::AlignCenter);
 
+  // Cancel Button
+  btn_cancel_ = new QPushButton( this );
+  btn_cancel_->setText("&Cancel");
+  btn_cancel_->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred );
+  btn_cancel_->hide(); // only show when computation begins
+  connect(btn_cancel_, SIGNAL(clicked()), this, SLOT(cancelCollisionTable()));
+  layout_->addWidget(btn_cancel_);
+  layout_->setAlignment( btn_cancel_, Qt::AlignRight );
+
   // Table Area --------------------------------------------
 
   // Table
   collision_table_ = new QTableWidget( this );
-  collision_table_->setColumnCount(4);
+  collision_table_->setColumnCount(5);
   collision_table_->setSortingEnabled(true);
   collision_table_->setSelectionBehavior( QAbstractItemView::SelectRows );
   connect(collision_table_, SIGNAL(cellClicked(int, int)), this, SLOT(previewClicked(int, int)));
@@ -163,6 +218,7 @@ DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
   header_list.append("Link B");
   header_list.append("Disabled");
   header_list.append("Reason To Disable");
+  header_list.append("Collision Frequency");
   collision_table_->setHorizontalHeaderLabels(header_list);
 
   // Resize headers
@@ -170,6 +226,7 @@ DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
   collision_table_->resizeColumnToContents(1);
   collision_table_->resizeColumnToContents(2);
   collision_table_->resizeColumnToContents(3);
+  collision_table_->resizeColumnToContents(4);
 
   // Bottom Area ----------------------------------------
   controls_box_bottom_ = new QGroupBox( this );
@@ -193,6 +250,24 @@ DefaultCollisionsWidget::DefaultCollisionsWidget( QWidget *parent,
   fraction_spinbox_->setSuffix("%");
   controls_box_bottom_layout->addWidget(fraction_spinbox_);
 
+  frequency_checkbox_ = new QCheckBox( this );
+  frequency_checkbox_->setText("Count Collisions");
+  frequency_checkbox_->setToolTip("Show how often each pair collides in the samples. Makes the sampling slower, "
+                                  "since pairs seen colliding are checked in every further sample");
+  controls_box_bottom_layout->addWidget(frequency_checkbox_);
+
+  rare_label_ = new QLabel(this);
+  rare_label_->setText("Max. collisions for \"rarely\"-colliding pairs:");
+  controls_box_bottom_layout->addWidget(rare_label_);
+
+  rare_spinbox_ = new QDoubleSpinBox(this);
+  rare_spinbox_->setRange(0.0, 100.0);
+  rare_spinbox_->setDecimals(2);
+  rare_spinbox_->setSingleStep(0.1);
+  rare_spinbox_->setValue(0.0); // only disable pairs that never collide
+  rare_spinbox_->setSuffix("%");
+  controls_box_bottom_layout->addWidget(rare_spinbox_);
+
   controls_box_bottom_layout->setAlignment(collision_checkbox_, Qt::AlignLeft);
 
   setLayout(layout_);
@@ -222,37 +297,42 @@ void DefaultCollisionsWidget::generateCollisionTable()
   // Disable controls on form
   disableControls(true);
 
-  // Create a progress variable that will be shared with the compute_default_collisions tool and its threads
-  // NOTE: be sure not to delete this variable until the subprograms have finished using it. Because of the simple
-  // use case of this variable (1 thread writes to it, the parent process reads it) it was decided a boost shared
-  // pointer is not necessary.
-  unsigned int collision_progress = 0;
-  progress_bar_->setValue(collision_progress);
+  // Create a progress object that will be shared with the compute_default_collisions tool and its threads
+  // NOTE: be sure not to delete this object until the subprograms have finished using it. It is only used while
+  // the worker task runs, so a boost shared pointer is not necessary.
+  moveit_setup_assistant::DefaultCollisionsProgress collision_progress;
+  collision_progress_ = &collision_progress;
+  progress_bar_->setValue(0);
 
   QApplication::processEvents(); // allow the progress bar to be shown
 
-  // Create thread to do actual work
-  boost::thread workerThread( boost::bind( &DefaultCollisionsWidget::generateCollisionTableThread,
-                                           this, &collision_progress ));
-  // Check interval
-  boost::posix_time::seconds check_interval(1);
+  // Do the actual work on the worker pool, whose threads are kept for the next run
+  WorkerPool::getInstance().reserve(1);
+  WorkerPool::TaskGroup worker;
+  worker.submit( boost::bind( &DefaultCollisionsWidget::generateCollisionTableThread,
+                              this, &collision_progress ));
+  // Check interval, short enough for the cancel button to react quickly
+  boost::posix_time::milliseconds check_interval(100);
 
   // Continually loop until threaded computation is finished
-  while( collision_progress < 100 )
+  while( !worker.timedWait(check_interval) )
   {
     // Set updated progress value.
-    progress_bar_->setValue(collision_progress);
+    progress_bar_->setValue(collision_progress.getPercent());
+
+    QString status = QString("Computing default collision matrix for robot model: %1")
+      .arg(defaultCollisionsPhaseToString(collision_progress.getPhase()).c_str());
+    double remaining = collision_progress.getRemainingTime();
+    if (remaining >= 0.0)
+      status.append(QString(", about %1 s remaining").arg((int)std::ceil(remaining)));
+    if (collision_progress.isCancelled())
+      status = "Cancelling...";
+    progress_label_->setText(status);
 
     // Allow GUI thread to do its stuff
     QApplication::processEvents();
-
-    // 1 second sleep
-    boost::this_thread::sleep(check_interval);
-    //usleep(1000 * 1000);
   }
-
-  // Wait for thread to finish
-  workerThread.join();
+  collision_progress_ = NULL;
 
   // Load the results into the GUI
   loadCollisionTable();
@@ -264,32 +344,61 @@ void DefaultCollisionsWidget::generateCollisionTable()
 // ******************************************************************************************
 // The thread that is called to allow the GUI to update. Calls an external function to do calcs
 // ******************************************************************************************
-void DefaultCollisionsWidget::generateCollisionTableThread( unsigned int *collision_progress )
+void DefaultCollisionsWidget::generateCollisionTableThread( DefaultCollisionsProgress *collision_progress )
 {
-  unsigned int num_trials = density_slider_->value() * 1000 + 1000; // scale to trials amount
-  double min_frac = (double)fraction_spinbox_->value() / 100.0;
-
-  const bool verbose = true; // Output benchmarking and statistics
-  const bool include_never_colliding = true;
+  DefaultCollisionsRequest request;
+  request.trials = density_slider_->value() * 1000 + 1000; // scale to trials amount
+  request.min_collision_fraction = (double)fraction_spinbox_->value() / 100.0;
+  request.verbose = true; // Output benchmarking and statistics
+  request.include_never_colliding = true;
+  // Counting keeps the pairs seen colliding checked in every sample, so it costs time and is only done on request.
+  // The threshold counts collisions anyway
+  request.record_collision_frequency = frequency_checkbox_->isChecked();
+  request.max_collision_frequency = rare_spinbox_->value() / 100.0;
+
+  // With a time budget, sample until the time is up or new colliding pairs got unlikely. A quarter of the samples
+  // focus on the pairs that are still undecided
+  if (budget_checkbox_->isChecked())
+  {
+    request.trials = std::numeric_limits<unsigned int>::max();
+    request.time_budget = budget_spinbox_->value();
+    request.max_discovery_rate = 1e-4;
+    request.focus_fraction = 0.25;
+  }
 
   // clear previously loaded collision matrix entries
   config_data_->getPlanningScene()->getAllowedCollisionMatrixNonConst().clear();
 
   // Find the default collision matrix - all links that are allowed to collide
-  link_pairs_ =
-    moveit_setup_assistant::computeDefaultCollisions( config_data_->getPlanningScene(),
-                                                      collision_progress, include_never_colliding, num_trials,
-                                                      min_frac, verbose);
+  DefaultCollisionsReport report;
+  LinkPairMap link_pairs =
+    moveit_setup_assistant::computeDefaultCollisions( config_data_->getPlanningScene(), request,
+                                                      collision_progress, &report );
+  if (report.cancelled)
+  {
+    ROS_INFO_STREAM("Computation of the default collision matrix cancelled");
+    return; // keep the previous link pairs
+  }
+  link_pairs_ = link_pairs;
+  if (request.time_budget > 0.0)
+    ROS_INFO_STREAM("Checked " << report.trials << " samples in the time budget, confidence reached "
+                    << report.confidence_reached);
 
   // Copy data changes to srdf_writer object
   linkPairsToSRDF();
 
-  // End the progress bar loop
-  *collision_progress = 100;
-
   ROS_INFO_STREAM("Thread complete " << link_pairs_.size());
 }
 
+// ******************************************************************************************
+// Stop the computation of the collision matrix
+// ******************************************************************************************
+void DefaultCollisionsWidget::cancelCollisionTable()
+{
+  if (collision_progress_)
+    collision_progress_->cancel();
+}
+
 // ******************************************************************************************
 // Displays data in the link_pairs_ data structure into a QtTableWidget
 // ******************************************************************************************
@@ -351,11 +460,15 @@ void DefaultCollisionsWidget::loadCollisionTable()
       QTableWidgetItem* reason = new QTableWidgetItem( longReasonsToString.at( pair_it->second.reason ) );
       reason->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
 
+      FrequencySortWidgetItem* frequency = new FrequencySortWidgetItem( pair_it->second.collision_frequency );
+      frequency->setFlags(Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+
       // Insert row elements into collision table
       collision_table_->setItem( row, 0, linkA);
       collision_table_->setItem( row, 1, linkB);
       collision_table_->setItem( row, 2, disable_check);
       collision_table_->setItem( row, 3, reason);
+      collision_table_->setItem( row, 4, frequency);
 
       // Increment row count
       ++row;
@@ -381,6 +494,7 @@ void DefaultCollisionsWidget::loadCollisionTable()
   collision_table_->resizeColumnToContents(1);
   collision_table_->resizeColumnToContents(2);
   collision_table_->resizeColumnToContents(3);
+  collision_table_->resizeColumnToContents(4);
   collision_table_->setVisible(true);
 
   collision_table_->setUpdatesEnabled(true); // prevent table from updating until we are completely done
@@ -407,11 +521,13 @@ void DefaultCollisionsWidget::disableControls(bool disable)
   {
     progress_bar_->show(); // only show when computation begins
     progress_label_->show();
+    btn_cancel_->show();
   }
   else
   {
     progress_label_->hide();
     progress_bar_->hide();
+    btn_cancel_->hide();
   }
 
   QApplication::processEvents(); // allow the progress bar to be shown
@@ -522,6 +638,15 @@ void DefaultCollisionsWidget::linkPairsToSRDF()
 // ******************************************************************************************
 void DefaultCollisionsWidget::linkPairsFromSRDF()
 {
+  // The SRDF does not store collision frequencies, keep the ones of the last computation
+  std::map<std::pair<std::string, std::string>, double> frequencies;
+  for ( moveit_setup_assistant::LinkPairMap::const_iterator pair_it = link_pairs_.begin();
+        pair_it != link_pairs_.end(); ++pair_it)
+  {
+    if( pair_it->second.collision_frequency >= 0.0 )
+      frequencies[ pair_it->first ] = pair_it->second.collision_frequency;
+  }
+
   // Clear all the previous data in the compute_default_collisions tool
   link_pairs_.clear();
 
@@ -551,6 +676,14 @@ void DefaultCollisionsWidget::linkPairsFromSRDF()
     // Insert into map
     link_pairs_[ link_pair ] = link_pair_data;
   }
+
+  for( std::map<std::pair<std::string, std::string>, double>::const_iterator frequency_it = frequencies.begin();
+       frequency_it != frequencies.end(); ++frequency_it )
+  {
+    moveit_setup_assistant::LinkPairMap::iterator pair_it = link_pairs_.find( frequency_it->first );
+    if( pair_it != link_pairs_.end() )
+      pair_it->second.collision_frequency = frequency_it->second;
+  }
 }
 
 // ******************************************************************************************
@@ -47,6 +47,7 @@
 #include <QProgressBar>
 #include <QCheckBox>
 #include <QSpinBox>
+#include <QDoubleSpinBox>
 
 #ifndef Q_MOC_RUN
 #include <boost/thread.hpp>
@@ -101,6 +102,11 @@ private Q_SLOTS:
    */
   void generateCollisionTable();
 
+  /**
+   * \brief Stops a running computation of the collision matrix, the previous matrix is kept
+   */
+  void cancelCollisionTable();
+
   /**
    * \brief GUI func for showing sampling density amount
    * \param value Sampling density
@@ -143,7 +149,10 @@ private:
   QVBoxLayout *layout_;
   QLabel *density_value_label_;
   QSlider *density_slider_;
+  QCheckBox *budget_checkbox_;
+  QSpinBox *budget_spinbox_;
   QPushButton *btn_generate_;
+  QPushButton *btn_cancel_;
   QGroupBox *controls_box_;
   QProgressBar *progress_bar_;
   QLabel *progress_label_;
@@ -151,6 +160,9 @@ private:
   QGroupBox *controls_box_bottom_;
   QLabel *fraction_label_;
   QSpinBox *fraction_spinbox_;
+  QCheckBox *frequency_checkbox_;
+  QLabel *rare_label_;
+  QDoubleSpinBox *rare_spinbox_;
   QTimer *update_timer_;
 
   // ******************************************************************************************
@@ -163,16 +175,19 @@ private:
   /// Contains all the configuration data for the setup assistant
   moveit_setup_assistant::MoveItConfigDataPtr config_data_;
 
+  /// Progress of the running computation, NULL if none is running
+  moveit_setup_assistant::DefaultCollisionsProgress *collision_progress_;
+
   // ******************************************************************************************
   // Private Functions
   // ******************************************************************************************
 
   /**
    * \brief The thread that is called to allow the GUI to update. Calls an external function to do calcs
-   * \param collision_progress A shared pointer between 3 threads to allow progress bar to update. See declaration
-   * location for more details and warning.
+   * \param collision_progress Shared between the threads to allow progress bar to update and the computation to be
+   * cancelled. See declaration location for more details and warning.
    */
-  void generateCollisionTableThread( unsigned int *collision_progress );
+  void generateCollisionTableThread( moveit_setup_assistant::DefaultCollisionsProgress *collision_progress );
 
   /**
    * \brief Helper function to disable parts of GUI during computation
@@ -51,6 +51,7 @@
 // SA
 #include "header_widget.h" // title and instructions
 #include "start_screen_widget.h"
+#include <moveit/setup_assistant/tools/file_loader.h> // for loading xacro files
 // C
 #include <fstream>  // for reading in urdf
 #include <streambuf>
@@ -505,24 +506,13 @@ bool StartScreenWidget::loadURDFFile( const std::string& urdf_file_path )
 
   if (urdf_file_path.find(".xacro") != std::string::npos)
   {
-    std::string cmd("rosrun xacro xacro.py ");
-    cmd += urdf_file_path;
-    ROS_INFO( "Running '%s'...", cmd.c_str() );
-
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe)
+    ROS_INFO( "Running xacro on '%s'...", urdf_file_path.c_str() );
+    if (!loadXacroFileToString(urdf_string, urdf_file_path, std::vector<std::string>()))
     {
       QMessageBox::warning( this, "Error Loading Files", QString( "XACRO file or parser not found: " ).append( urdf_file_path.c_str() ) );
       return false;
     }
-    char buffer[128] = {0};
-    while (!feof(pipe))
-    {
-      if (fgets(buffer, sizeof(buffer), pipe) != NULL)
-        urdf_string += buffer;
-    }
-    pclose(pipe);
-    
+
     if (urdf_string.empty())
     {
       QMessageBox::warning( this, "Error Loading Files", QString( "Unable to parse XACRO file: " ).append( urdf_file_path.c_str() ) );
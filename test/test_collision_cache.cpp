@@ -0,0 +1,238 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/collision_cache.h>
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+
+using namespace moveit_setup_assistant;
+
+class CollisionCacheTest : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    path_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code error;
+    boost::filesystem::remove(path_, error);
+  }
+
+  static LinkPairData makeData(DisabledReason reason, double frequency)
+  {
+    LinkPairData data;
+    data.reason = reason;
+    data.disable_check = reason != NOT_DISABLED;
+    data.collision_frequency = frequency;
+    data.min_distance = 0.25;
+    return data;
+  }
+
+  std::string readFile() const
+  {
+    std::ifstream in(path_.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  void writeFile(const std::string &content) const
+  {
+    std::ofstream out(path_.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+  }
+
+  std::string path_;
+};
+
+TEST_F(CollisionCacheTest, RoundTrip)
+{
+  CollisionCache cache;
+  cache.store(1, makeData(NEVER, 0.0));
+  cache.store(0xffffffffffffffffULL, makeData(ALWAYS, 0.5));
+  cache.store(7, makeData(NOT_DISABLED, -1.0));
+  cache.store(8, makeData(RARELY, 0.125));
+  ASSERT_TRUE(cache.save(path_));
+
+  CollisionCache loaded;
+  ASSERT_TRUE(loaded.load(path_));
+  EXPECT_EQ(4u, loaded.size());
+
+  LinkPairData data;
+  ASSERT_TRUE(loaded.lookup(0xffffffffffffffffULL, data));
+  EXPECT_EQ(ALWAYS, data.reason);
+  EXPECT_TRUE(data.disable_check);
+  EXPECT_EQ(0.5, data.collision_frequency);
+  EXPECT_EQ(0.25, data.min_distance);
+
+  ASSERT_TRUE(loaded.lookup(7, data));
+  EXPECT_EQ(NOT_DISABLED, data.reason);
+  EXPECT_FALSE(data.disable_check);
+  EXPECT_EQ(-1.0, data.collision_frequency);
+
+  ASSERT_TRUE(loaded.lookup(8, data));
+  EXPECT_EQ(RARELY, data.reason);
+  EXPECT_FALSE(loaded.lookup(2, data));
+}
+
+TEST_F(CollisionCacheTest, TruncatedFiles)
+{
+  CollisionCache cache;
+  for (boost::uint64_t key = 0 ; key < 3 ; ++key)
+    cache.store(key, makeData(NEVER, 0.0));
+  ASSERT_TRUE(cache.save(path_));
+  const std::string content = readFile();
+
+  // Every shorter prefix fails and leaves the cache empty
+  for (std::size_t size = 0 ; size < content.size() ; ++size)
+  {
+    writeFile(content.substr(0, size));
+    CollisionCache loaded;
+    loaded.store(99, makeData(NEVER, 0.0));
+    EXPECT_FALSE(loaded.load(path_)) << size << " bytes";
+    EXPECT_EQ(0u, loaded.size()) << size << " bytes";
+  }
+}
+
+TEST_F(CollisionCacheTest, Garbage)
+{
+  CollisionCache loaded;
+  writeFile("MSACACH");
+  EXPECT_FALSE(loaded.load(path_));
+  writeFile("MSACHKPT\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00");
+  EXPECT_FALSE(loaded.load(path_));
+  writeFile(std::string("MSACACHE\x63\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 20));
+  EXPECT_FALSE(loaded.load(path_));
+
+  // A count far beyond the records in the file
+  writeFile(std::string("MSACACHE\x03\x00\x00\x00\x00\x00\x00\x00\xff\xff\xff\xff", 20));
+  EXPECT_FALSE(loaded.load(path_));
+  EXPECT_EQ(0u, loaded.size());
+
+  // A reason beyond the last one
+  std::string content("MSACACHE\x03\x00\x00\x00\x00\x00\x00\x00\x01\x00\x00\x00", 20);
+  content += std::string(8, '\x00') + std::string("\x08\x01", 2) + std::string(12, '\x00');
+  writeFile(content);
+  EXPECT_FALSE(loaded.load(path_));
+  EXPECT_EQ(0u, loaded.size());
+
+  EXPECT_FALSE(loaded.load(path_ + ".missing"));
+}
+
+TEST_F(CollisionCacheTest, Version1)
+{
+  // Header without generation, records without generation
+  std::string content("MSACACHE\x01\x00\x00\x00\x01\x00\x00\x00", 16);
+  content += std::string("\x05\x00\x00\x00\x00\x00\x00\x00", 8); // key
+  content += std::string("\x03\x01", 2); // ALWAYS, disabled
+  content += std::string("\x00\x00\x00\x3f", 4); // 0.5
+  content += std::string("\x00\x00\x80\xbf", 4); // -1.0
+  writeFile(content);
+
+  CollisionCache loaded;
+  ASSERT_TRUE(loaded.load(path_));
+  LinkPairData data;
+  ASSERT_TRUE(loaded.lookup(5, data));
+  EXPECT_EQ(ALWAYS, data.reason);
+  EXPECT_TRUE(data.disable_check);
+  EXPECT_EQ(0.5, data.collision_frequency);
+  EXPECT_EQ(-1.0, data.min_distance);
+}
+
+TEST_F(CollisionCacheTest, Version2Reasons)
+{
+  // Version 2 numbered UNREACHABLE 4, USER 5 and NOT_DISABLED 6
+  std::string content("MSACACHE\x02\x00\x00\x00\x00\x00\x00\x00\x03\x00\x00\x00", 20);
+  for (char reason = 4 ; reason <= 6 ; ++reason)
+  {
+    content += std::string(1, reason) + std::string("\x00\x00\x00\x00\x00\x00\x00", 7); // key
+    content += std::string(1, reason) + std::string("\x01", 1);
+    content += std::string("\x00\x00\x80\xbf\x00\x00\x80\xbf\x00\x00\x00\x00", 12);
+  }
+  writeFile(content);
+
+  CollisionCache loaded;
+  ASSERT_TRUE(loaded.load(path_));
+  LinkPairData data;
+  ASSERT_TRUE(loaded.lookup(4, data));
+  EXPECT_EQ(UNREACHABLE, data.reason);
+  ASSERT_TRUE(loaded.lookup(5, data));
+  EXPECT_EQ(USER, data.reason);
+  ASSERT_TRUE(loaded.lookup(6, data));
+  EXPECT_EQ(NOT_DISABLED, data.reason);
+}
+
+TEST_F(CollisionCacheTest, PrunesLeastRecentlyUsed)
+{
+  CollisionCache cache;
+  for (boost::uint64_t key = 0 ; key < 10 ; ++key)
+    cache.store(key, makeData(NEVER, 0.0));
+  ASSERT_TRUE(cache.save(path_));
+
+  // The next run uses two old entries and adds one
+  CollisionCache second;
+  ASSERT_TRUE(second.load(path_));
+  LinkPairData data;
+  EXPECT_TRUE(second.lookup(3, data));
+  EXPECT_TRUE(second.lookup(7, data));
+  second.store(20, makeData(ALWAYS, 1.0));
+  second.setMaxEntries(5);
+  ASSERT_TRUE(second.save(path_));
+
+  CollisionCache third;
+  ASSERT_TRUE(third.load(path_));
+  EXPECT_EQ(5u, third.size());
+  EXPECT_TRUE(third.lookup(3, data));
+  EXPECT_TRUE(third.lookup(7, data));
+  EXPECT_TRUE(third.lookup(20, data));
+  EXPECT_EQ(ALWAYS, data.reason);
+
+  // No limit keeps everything
+  third.setMaxEntries(0);
+  for (boost::uint64_t key = 100 ; key < 200 ; ++key)
+    third.store(key, makeData(NEVER, 0.0));
+  ASSERT_TRUE(third.save(path_));
+  CollisionCache fourth;
+  ASSERT_TRUE(fourth.load(path_));
+  EXPECT_EQ(105u, fourth.size());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,168 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/collision_checkpoint.h>
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+#include <iterator>
+
+using namespace moveit_setup_assistant;
+
+class CollisionCheckpointTest : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    path_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+
+    checkpoint_.key = 0x0123456789abcdefULL;
+    checkpoint_.trials_done = 5000;
+    checkpoint_.focused_trials = 1000;
+    checkpoint_.last_discovery = 1234;
+    checkpoint_.seen_colliding.resize(70);
+    checkpoint_.seen_colliding.set(0);
+    checkpoint_.seen_colliding.set(69);
+    checkpoint_.near_pairs.resize(70);
+    checkpoint_.near_pairs.set(33);
+    checkpoint_.collision_count.assign(70, 3);
+    checkpoint_.min_distance.assign(70, 0.5f);
+    checkpoint_.closest_distance.assign(3, 0.125);
+    checkpoint_.closest_trial.assign(3, 17);
+    checkpoint_.closest_positions.resize(3);
+    checkpoint_.closest_positions[1].assign(6, -1.5);
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code error;
+    boost::filesystem::remove(path_, error);
+  }
+
+  std::string readFile() const
+  {
+    std::ifstream in(path_.c_str(), std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+  void writeFile(const std::string &content) const
+  {
+    std::ofstream out(path_.c_str(), std::ios::binary | std::ios::trunc);
+    out << content;
+  }
+
+  std::string path_;
+  CollisionCheckpoint checkpoint_;
+};
+
+TEST_F(CollisionCheckpointTest, RoundTrip)
+{
+  ASSERT_TRUE(saveCollisionCheckpoint(path_, checkpoint_));
+
+  CollisionCheckpoint loaded;
+  ASSERT_TRUE(loadCollisionCheckpoint(path_, loaded));
+  EXPECT_EQ(checkpoint_.key, loaded.key);
+  EXPECT_EQ(checkpoint_.trials_done, loaded.trials_done);
+  EXPECT_EQ(checkpoint_.focused_trials, loaded.focused_trials);
+  EXPECT_EQ(checkpoint_.last_discovery, loaded.last_discovery);
+  EXPECT_EQ(checkpoint_.seen_colliding, loaded.seen_colliding);
+  EXPECT_EQ(checkpoint_.near_pairs, loaded.near_pairs);
+  EXPECT_EQ(checkpoint_.collision_count, loaded.collision_count);
+  EXPECT_EQ(checkpoint_.min_distance, loaded.min_distance);
+  EXPECT_EQ(checkpoint_.closest_distance, loaded.closest_distance);
+  EXPECT_EQ(checkpoint_.closest_trial, loaded.closest_trial);
+  EXPECT_EQ(checkpoint_.closest_positions, loaded.closest_positions);
+}
+
+TEST_F(CollisionCheckpointTest, EmptyRoundTrip)
+{
+  ASSERT_TRUE(saveCollisionCheckpoint(path_, CollisionCheckpoint()));
+
+  CollisionCheckpoint loaded;
+  ASSERT_TRUE(loadCollisionCheckpoint(path_, loaded));
+  EXPECT_EQ(0u, loaded.trials_done);
+  EXPECT_EQ(0u, loaded.seen_colliding.size());
+  EXPECT_TRUE(loaded.closest_positions.empty());
+}
+
+TEST_F(CollisionCheckpointTest, TruncatedFiles)
+{
+  ASSERT_TRUE(saveCollisionCheckpoint(path_, checkpoint_));
+  const std::string content = readFile();
+
+  for (std::size_t size = 0 ; size < content.size() ; ++size)
+  {
+    writeFile(content.substr(0, size));
+    CollisionCheckpoint loaded;
+    EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded)) << size << " bytes";
+  }
+}
+
+TEST_F(CollisionCheckpointTest, Garbage)
+{
+  CollisionCheckpoint loaded;
+  writeFile("MSACACHE\x01\x00\x00\x00");
+  EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded));
+  writeFile(std::string("MSACHKPT\x02\x00\x00\x00", 12));
+  EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded));
+
+  // Sizes far beyond the file must fail instead of allocating
+  ASSERT_TRUE(saveCollisionCheckpoint(path_, CollisionCheckpoint()));
+  std::string content = readFile();
+  const std::size_t bitset_size = 8 + 4 + 8 + 4 + 4 + 4; // magic, version, key and three counters
+  content.replace(bitset_size, 8, std::string(8, '\xff'));
+  writeFile(content);
+  EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded));
+
+  content = readFile();
+  content.replace(bitset_size, 8, std::string(8, '\0'));
+  content.replace(bitset_size + 8, 8, std::string(8, '\xff'));
+  writeFile(content);
+  EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded));
+
+  // A bitset longer than its blocks
+  content = readFile();
+  content.replace(bitset_size, 8, std::string(8, '\x01'));
+  content.replace(bitset_size + 8, 8, std::string(8, '\0'));
+  writeFile(content);
+  EXPECT_FALSE(loadCollisionCheckpoint(path_, loaded));
+
+  EXPECT_FALSE(loadCollisionCheckpoint(path_ + ".missing", loaded));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
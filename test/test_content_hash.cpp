@@ -0,0 +1,95 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/content_hash.h>
+#include <gtest/gtest.h>
+
+using namespace moveit_setup_assistant;
+
+TEST(ContentHash, EmptyIsOffsetBasis)
+{
+  // FNV-1a 64 of no data
+  EXPECT_EQ(14695981039346656037ULL, ContentHash().value());
+}
+
+TEST(ContentHash, StringRoundTrip)
+{
+  const boost::uint64_t values[] = { 0ULL, 1ULL, 0xffffffffffffffffULL, 0x0123456789abcdefULL,
+                                     ContentHash().add(std::string("link")).value() };
+  for (std::size_t i = 0 ; i < sizeof(values) / sizeof(values[0]) ; ++i)
+  {
+    const std::string text = ContentHash::toString(values[i]);
+    EXPECT_EQ(16u, text.size());
+
+    boost::uint64_t parsed = values[i] + 1;
+    EXPECT_TRUE(ContentHash::fromString(text, parsed));
+    EXPECT_EQ(values[i], parsed);
+  }
+  EXPECT_EQ("0123456789abcdef", ContentHash::toString(0x0123456789abcdefULL));
+}
+
+TEST(ContentHash, RejectsGarbage)
+{
+  boost::uint64_t hash = 42;
+  EXPECT_FALSE(ContentHash::fromString("", hash));
+  EXPECT_FALSE(ContentHash::fromString("0123456789abcde", hash));
+  EXPECT_FALSE(ContentHash::fromString("0123456789abcdef0", hash));
+  EXPECT_FALSE(ContentHash::fromString("0123456789abcdeg", hash));
+  EXPECT_FALSE(ContentHash::fromString("not a hash at al", hash));
+  EXPECT_EQ(42u, hash);
+}
+
+TEST(ContentHash, StringsDoNotRunIntoEachOther)
+{
+  EXPECT_NE(ContentHash().add(std::string("ab")).add(std::string("c")).value(),
+            ContentHash().add(std::string("a")).add(std::string("bc")).value());
+}
+
+TEST(ContentHash, OrderMatters)
+{
+  EXPECT_NE(ContentHash().add((boost::uint64_t)1).add((boost::uint64_t)2).value(),
+            ContentHash().add((boost::uint64_t)2).add((boost::uint64_t)1).value());
+}
+
+TEST(ContentHash, NegativeZero)
+{
+  EXPECT_EQ(ContentHash().add(0.0).value(), ContentHash().add(-0.0).value());
+  EXPECT_NE(ContentHash().add(0.0).value(), ContentHash().add(1e-300).value());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,70 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/compute_default_collisions.h>
+#include <gtest/gtest.h>
+
+using namespace moveit_setup_assistant;
+
+TEST(DiscoveryRate, Bound)
+{
+  EXPECT_EQ(1.0, discoveryRateBound(0, 0.95));
+
+  // Rule of three: no discovery in n trials bounds the rate by about 3 / n at 95% confidence
+  EXPECT_NEAR(3.0 / 1000, discoveryRateBound(1000, 0.95), 1e-5);
+  EXPECT_NEAR(1.0 - 0.05, discoveryRateBound(1, 0.95), 1e-12);
+
+  // More trials or less confidence give a lower bound
+  EXPECT_LT(discoveryRateBound(2000, 0.95), discoveryRateBound(1000, 0.95));
+  EXPECT_LT(discoveryRateBound(1000, 0.9), discoveryRateBound(1000, 0.95));
+}
+
+TEST(DiscoveryRate, ConfidenceIsInverse)
+{
+  const unsigned int trials[] = { 1, 10, 1000, 100000 };
+  const double confidences[] = { 0.5, 0.9, 0.95, 0.999 };
+  for (std::size_t i = 0 ; i < sizeof(trials) / sizeof(trials[0]) ; ++i)
+    for (std::size_t j = 0 ; j < sizeof(confidences) / sizeof(confidences[0]) ; ++j)
+      EXPECT_NEAR(confidences[j], discoveryConfidence(trials[i], discoveryRateBound(trials[i], confidences[j])), 1e-9);
+
+  EXPECT_EQ(0.0, discoveryConfidence(0, 0.5));
+  EXPECT_EQ(1.0, discoveryConfidence(10, 1.0));
+  EXPECT_EQ(1.0, discoveryConfidence(10, 2.0));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,155 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/incremental_result.h>
+#include <boost/filesystem.hpp>
+#include <gtest/gtest.h>
+#include <fstream>
+
+using namespace moveit_setup_assistant;
+
+class IncrementalResultTest : public testing::Test
+{
+protected:
+  virtual void SetUp()
+  {
+    path_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()).string();
+  }
+
+  virtual void TearDown()
+  {
+    boost::system::error_code error;
+    boost::filesystem::remove(path_, error);
+  }
+
+  static LinkPairData makeData(DisabledReason reason, double frequency)
+  {
+    LinkPairData data;
+    data.reason = reason;
+    data.disable_check = reason != NOT_DISABLED;
+    data.collision_frequency = frequency;
+    data.min_distance = 0.25;
+    return data;
+  }
+
+  void writeFile(const std::string &content) const
+  {
+    std::ofstream out(path_.c_str(), std::ios::trunc);
+    out << content;
+  }
+
+  std::string path_;
+};
+
+TEST_F(IncrementalResultTest, RoundTripKeepsEveryPair)
+{
+  IncrementalResult result;
+  result.settings_hash = 0x0123456789abcdefULL;
+  result.link_hashes["base"].geometry = 1;
+  result.link_hashes["base"].joint = 2;
+  result.link_hashes["arm"].geometry = 3;
+  result.link_hashes["arm"].joint = 0xffffffffffffffffULL;
+  result.link_pairs[std::make_pair("arm", "base")] = makeData(ADJACENT, -1.0);
+  result.link_pairs[std::make_pair("arm", "hand")] = makeData(NOT_DISABLED, 0.5);
+  result.link_pairs[std::make_pair("base", "hand")] = makeData(NEVER, 0.0);
+  ASSERT_TRUE(saveIncrementalResult(path_, result));
+  EXPECT_FALSE(boost::filesystem::exists(path_ + ".tmp"));
+
+  IncrementalResult loaded;
+  ASSERT_TRUE(loadIncrementalResult(path_, loaded));
+  EXPECT_EQ(result.settings_hash, loaded.settings_hash);
+  ASSERT_EQ(2u, loaded.link_hashes.size());
+  EXPECT_EQ(3u, loaded.link_hashes["arm"].geometry);
+  EXPECT_EQ(0xffffffffffffffffULL, loaded.link_hashes["arm"].joint);
+
+  // The enabled pair is written as well, an incremental run must not sample it again
+  ASSERT_EQ(3u, loaded.link_pairs.size());
+  const LinkPairData &enabled = loaded.link_pairs[std::make_pair("arm", "hand")];
+  EXPECT_EQ(NOT_DISABLED, enabled.reason);
+  EXPECT_FALSE(enabled.disable_check);
+  EXPECT_DOUBLE_EQ(0.5, enabled.collision_frequency);
+  EXPECT_DOUBLE_EQ(0.25, enabled.min_distance);
+  EXPECT_EQ(ADJACENT, loaded.link_pairs[std::make_pair("arm", "base")].reason);
+  EXPECT_TRUE(loaded.link_pairs[std::make_pair("base", "hand")].disable_check);
+}
+
+TEST_F(IncrementalResultTest, PairKeysAreOrdered)
+{
+  writeFile("settings: 0000000000000001\n"
+            "links: {}\n"
+            "pairs:\n"
+            "  - {link1: hand, link2: arm, reason: Never, disabled: true, frequency: 0, distance: 0.1}\n");
+
+  IncrementalResult loaded;
+  ASSERT_TRUE(loadIncrementalResult(path_, loaded));
+  ASSERT_EQ(1u, loaded.link_pairs.size());
+  EXPECT_EQ(std::make_pair(std::string("arm"), std::string("hand")), loaded.link_pairs.begin()->first);
+}
+
+TEST_F(IncrementalResultTest, OldFormatHasNoVerdicts)
+{
+  // Older versions wrote a plain map of the links, every pair is computed again
+  writeFile("base: {geometry: 0000000000000001, joint: 0000000000000002}\n");
+
+  IncrementalResult loaded;
+  ASSERT_TRUE(loadIncrementalResult(path_, loaded));
+  EXPECT_EQ(0u, loaded.settings_hash);
+  ASSERT_EQ(1u, loaded.link_hashes.size());
+  EXPECT_EQ(2u, loaded.link_hashes["base"].joint);
+  EXPECT_TRUE(loaded.link_pairs.empty());
+}
+
+TEST_F(IncrementalResultTest, RejectsInvalidHashes)
+{
+  writeFile("settings: 0000000000000001\n"
+            "links:\n"
+            "  base: {geometry: xyz, joint: 0000000000000002}\n");
+
+  IncrementalResult loaded;
+  EXPECT_FALSE(loadIncrementalResult(path_, loaded));
+  EXPECT_TRUE(loaded.link_hashes.empty());
+  EXPECT_EQ(0u, loaded.settings_hash);
+}
+
+TEST_F(IncrementalResultTest, MissingFileFails)
+{
+  IncrementalResult loaded;
+  EXPECT_FALSE(loadIncrementalResult(path_, loaded));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,110 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/joint_space_sampler.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace moveit_setup_assistant;
+
+TEST(ScrambledHalton, IdentityIsVanDerCorput)
+{
+  std::vector<unsigned int> identity(2);
+  identity[1] = 1;
+  const double expected[] = { 0.0, 0.5, 0.25, 0.75, 0.125, 0.625, 0.375, 0.875 };
+  for (unsigned int index = 0 ; index < sizeof(expected) / sizeof(expected[0]) ; ++index)
+    EXPECT_DOUBLE_EQ(expected[index], scrambledRadicalInverse(index, 2, identity));
+}
+
+TEST(ScrambledHalton, PermutedDigits)
+{
+  // Base 3 with the digits 1 and 2 swapped: 5 = 12 in base 3 mirrors to 0.21, scrambled to 0.12
+  std::vector<unsigned int> permutation(3);
+  permutation[1] = 2;
+  permutation[2] = 1;
+  EXPECT_DOUBLE_EQ(2.0 / 3, scrambledRadicalInverse(1, 3, permutation));
+  EXPECT_DOUBLE_EQ(1.0 / 3 + 2.0 / 9, scrambledRadicalInverse(5, 3, permutation));
+}
+
+TEST(ScrambledHalton, DigitPermutation)
+{
+  const unsigned int bases[] = { 2, 3, 5, 7, 31, 97 };
+  random_numbers::RandomNumberGenerator rng(42);
+  for (std::size_t i = 0 ; i < sizeof(bases) / sizeof(bases[0]) ; ++i)
+  {
+    std::vector<unsigned int> permutation;
+    randomDigitPermutation(bases[i], rng, permutation);
+    ASSERT_EQ(bases[i], permutation.size());
+    EXPECT_EQ(0u, permutation[0]);
+
+    std::vector<unsigned int> sorted(permutation);
+    std::sort(sorted.begin(), sorted.end());
+    for (unsigned int d = 0 ; d < bases[i] ; ++d)
+      EXPECT_EQ(d, sorted[d]);
+  }
+
+  // The same seed gives the same scrambling
+  random_numbers::RandomNumberGenerator rng_a(7), rng_b(7);
+  std::vector<unsigned int> a, b;
+  randomDigitPermutation(97, rng_a, a);
+  randomDigitPermutation(97, rng_b, b);
+  EXPECT_EQ(a, b);
+}
+
+TEST(ScrambledHalton, Stratified)
+{
+  // Any scrambling keeps the first base^k points in distinct intervals of width base^-k
+  random_numbers::RandomNumberGenerator rng(3);
+  const unsigned int base = 5;
+  std::vector<unsigned int> permutation;
+  randomDigitPermutation(base, rng, permutation);
+
+  const unsigned int count = base * base * base;
+  std::vector<bool> hit(count, false);
+  for (unsigned int index = 0 ; index < count ; ++index)
+  {
+    const double u = scrambledRadicalInverse(index, base, permutation);
+    ASSERT_GE(u, 0.0);
+    ASSERT_LT(u, 1.0);
+    const unsigned int interval = (unsigned int)(u * count + 1e-9);
+    EXPECT_FALSE(hit[interval]) << "index " << index;
+    hit[interval] = true;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,157 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2016, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/setup_assistant/tools/compute_default_collisions.h>
+#include <gtest/gtest.h>
+#include <set>
+
+using namespace moveit_setup_assistant;
+
+static std::vector<std::string> makeLinkNames()
+{
+  // Unsorted and with a duplicate
+  std::vector<std::string> names;
+  names.push_back("wrist");
+  names.push_back("base");
+  names.push_back("shoulder");
+  names.push_back("elbow");
+  names.push_back("base");
+  names.push_back("hand");
+  return names;
+}
+
+TEST(LinkPairMatrix, Interning)
+{
+  const LinkPairMatrix matrix(makeLinkNames());
+  ASSERT_EQ(5u, matrix.linkCount());
+  EXPECT_EQ(10u, matrix.pairCount());
+
+  // Ids follow the alphabetical order
+  EXPECT_EQ(0, matrix.linkId("base"));
+  EXPECT_EQ(1, matrix.linkId("elbow"));
+  EXPECT_EQ(4, matrix.linkId("wrist"));
+  EXPECT_EQ(-1, matrix.linkId("gripper"));
+  for (std::size_t id = 0 ; id < matrix.linkCount() ; ++id)
+    EXPECT_EQ((int)id, matrix.linkId(matrix.linkName(id)));
+}
+
+TEST(LinkPairMatrix, PackedIndexing)
+{
+  const LinkPairMatrix matrix(makeLinkNames());
+
+  // Every pair gets its own index in 0 .. n choose 2, the same in both orders, matching the links stored for it
+  std::set<std::size_t> indices;
+  for (int a = 0 ; a < (int)matrix.linkCount() ; ++a)
+    for (int b = a + 1 ; b < (int)matrix.linkCount() ; ++b)
+    {
+      const std::size_t index = matrix.pairIndex(a, b);
+      ASSERT_LT(index, matrix.pairCount());
+      EXPECT_EQ(index, matrix.pairIndex(b, a));
+      EXPECT_EQ(a, matrix.firstLink(index));
+      EXPECT_EQ(b, matrix.secondLink(index));
+      EXPECT_TRUE(indices.insert(index).second);
+    }
+  EXPECT_EQ(matrix.pairCount(), indices.size());
+
+  std::size_t index;
+  ASSERT_TRUE(matrix.pairIndex("wrist", "base", index));
+  EXPECT_EQ(matrix.pairIndex(0, 4), index);
+  EXPECT_FALSE(matrix.pairIndex("base", "base", index));
+  EXPECT_FALSE(matrix.pairIndex("base", "gripper", index));
+}
+
+TEST(LinkPairMatrix, Empty)
+{
+  EXPECT_EQ(0u, LinkPairMatrix().pairCount());
+  EXPECT_EQ(0u, LinkPairMatrix(std::vector<std::string>(1, "base")).pairCount());
+}
+
+TEST(LinkPairMatrix, SetLinkPair)
+{
+  LinkPairMatrix matrix(makeLinkNames());
+  const std::size_t index = matrix.pairIndex(1, 2);
+  EXPECT_EQ(NOT_DISABLED, matrix.reason(index));
+  EXPECT_FALSE(matrix.disabled(index));
+
+  // The first reason sticks
+  EXPECT_TRUE(matrix.setLinkPair(index, ADJACENT));
+  EXPECT_FALSE(matrix.setLinkPair(index, NEVER));
+  EXPECT_EQ(ADJACENT, matrix.reason(index));
+  EXPECT_TRUE(matrix.disabled(index));
+
+  // NOT_DISABLED enables the pair again
+  matrix.setLinkPair(index, NOT_DISABLED);
+  EXPECT_FALSE(matrix.disabled(index));
+  EXPECT_TRUE(matrix.setLinkPair(index, RARELY));
+  EXPECT_EQ(RARELY, matrix.reason(index));
+
+  // The neighbours are untouched
+  EXPECT_FALSE(matrix.disabled(index - 1));
+  EXPECT_FALSE(matrix.disabled(index + 1));
+}
+
+TEST(LinkPairMatrix, ToLinkPairMap)
+{
+  LinkPairMatrix matrix(makeLinkNames());
+  LinkPairData data;
+  data.reason = ALWAYS;
+  data.disable_check = true;
+  data.collision_frequency = 0.75;
+  data.min_distance = 0.0;
+  matrix.setLinkPairData(matrix.pairIndex(0, 3), data);
+
+  LinkPairMap link_pairs;
+  matrix.toLinkPairMap(link_pairs);
+  ASSERT_EQ(matrix.pairCount(), link_pairs.size());
+
+  LinkPairMap::const_iterator pair = link_pairs.find(std::make_pair(std::string("base"), std::string("shoulder")));
+  ASSERT_TRUE(pair != link_pairs.end());
+  EXPECT_EQ(ALWAYS, pair->second.reason);
+  EXPECT_TRUE(pair->second.disable_check);
+  EXPECT_EQ(0.75, pair->second.collision_frequency);
+
+  // The map holds the same pairs in the same order as the matrix
+  std::size_t index = 0;
+  for (LinkPairMap::const_iterator it = link_pairs.begin() ; it != link_pairs.end() ; ++it, ++index)
+  {
+    EXPECT_EQ(matrix.linkName(matrix.firstLink(index)), it->first.first);
+    EXPECT_EQ(matrix.linkName(matrix.secondLink(index)), it->first.second);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}